@@ -0,0 +1,237 @@
+#include "AssetManager.hpp"
+#include "RenderQueue.hpp"
+#include "SDL2/SDL_image.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+void TextureHandle::reset() {
+    if(asset) owner->release(asset);
+    owner = nullptr;
+    asset = nullptr;
+}
+
+AssetManager::AssetManager(SDL_Renderer* renderer, RenderQueue* renderQueue)
+    : renderer(renderer), renderQueue(renderQueue) {
+    worker = std::thread(&AssetManager::workerLoop, this);
+}
+
+AssetManager::~AssetManager() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    wake.notify_one();
+    worker.join();
+
+    for(auto& result : results) {
+        if(result.surface) SDL_FreeSurface(result.surface);
+    }
+    for(auto& entry : assets) {
+        if(entry.second.texture) SDL_DestroyTexture(entry.second.texture);
+    }
+}
+
+std::string AssetManager::canonicalPath(const std::string& path) {
+    // "./image/a.png" и "image/../image/a.png" - один и тот же ресурс
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    if(error) return std::filesystem::path(path).lexically_normal().string();
+    return canonical.string();
+}
+
+TextureAsset* AssetManager::acquire(const std::string& path, bool& created) {
+    const std::string key = canonicalPath(path);
+    auto it = assets.find(key);
+    created = it == assets.end();
+    if(created) {
+        stats.misses++;
+        it = assets.emplace(key, TextureAsset()).first;
+        it->second.path = key;
+    } else {
+        stats.hits++;
+    }
+    it->second.refs++;
+    return &it->second;
+}
+
+void AssetManager::release(TextureAsset* asset) {
+    if(--asset->refs > 0) return;
+
+    if(asset->pending) {
+        // Результат, который уже в работе, освободит collect
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.erase(std::remove(jobs.begin(), jobs.end(), asset->path), jobs.end());
+    }
+    setTexture(*asset, nullptr, 0, 0);
+    assets.erase(asset->path);
+}
+
+TextureHandle AssetManager::load(const std::string& path, SDL_Surface* decodedSurface) {
+    bool created;
+    TextureAsset* asset = acquire(path, created);
+    TextureHandle handle(this, asset);
+    if(created) {
+        asset->pending = true;
+        std::vector<Decoded> ready{{asset->path, decodedSurface ? decodedSurface : decode(asset->path)}};
+        createTextures(ready, decodedSurface == nullptr);
+    } else if(asset->pending) {
+        finish(*asset);
+    }
+    if(!asset->texture) return TextureHandle();
+    return handle;
+}
+
+TextureHandle AssetManager::preload(const std::string& path) {
+    bool created;
+    TextureAsset* asset = acquire(path, created);
+    if(created) {
+        asset->pending = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(asset->path);
+        }
+        wake.notify_one();
+    }
+    return TextureHandle(this, asset);
+}
+
+SDL_Texture* AssetManager::get(const TextureHandle& handle) {
+    if(!handle.asset) return nullptr;
+    if(handle.asset->pending) finish(*handle.asset);
+    return handle.asset->texture;
+}
+
+void AssetManager::finish(TextureAsset& asset) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto job = std::find(jobs.begin(), jobs.end(), asset.path);
+    if(job != jobs.end()) {
+        // Очередь до него еще не дошла - декодируем сами, не дожидаясь остальных
+        jobs.erase(job);
+        lock.unlock();
+        std::vector<Decoded> ready{{asset.path, decode(asset.path)}};
+        createTextures(ready, true);
+        return;
+    }
+
+    // Фоновый поток уже декодирует файл
+    decoded.wait(lock, [&] {
+        return std::any_of(results.begin(), results.end(), [&](const Decoded& result) { return result.path == asset.path; });
+    });
+    lock.unlock();
+    collect();
+}
+
+void AssetManager::collect() {
+    std::vector<Decoded> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(results.empty()) return;
+        ready.swap(results);
+    }
+    createTextures(ready, true);
+}
+
+bool AssetManager::reload(const std::string& path) {
+    auto it = assets.find(canonicalPath(path));
+    if(it == assets.end()) return false;
+    TextureAsset& asset = it->second;
+    // Файл еще декодируется - новые данные уже попадут в него или придут следующим изменением
+    if(asset.pending) return true;
+
+    SDL_Surface* surface = decode(asset.path);
+    if(!surface) return true;  // Остается прежняя текстура
+    SDL_Texture* texture = nullptr;
+    renderQueue->run([&] { texture = SDL_CreateTextureFromSurface(renderer, surface); });
+    if(texture) {
+        setTexture(asset, texture, surface->w, surface->h);
+    } else {
+        std::cout << "Failed to create texture from image: " << SDL_GetError() << std::endl;
+    }
+    SDL_FreeSurface(surface);
+    return true;
+}
+
+void AssetManager::printStats(std::ostream& out) const {
+    const size_t requests = stats.hits + stats.misses;
+    out << "Assets: " << stats.textures << " textures, " << stats.bytes / 1024 << " KB (peak "
+        << stats.peakBytes / 1024 << " KB), hits " << stats.hits << ", misses " << stats.misses;
+    if(requests > 0) out << " (" << stats.hits * 100 / requests << "% hit rate)";
+    out << std::endl;
+}
+
+void AssetManager::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if(stopping) return;
+
+        std::string path = jobs.front();
+        jobs.pop_front();
+        lock.unlock();
+        SDL_Surface* surface = decode(path);
+        lock.lock();
+        results.push_back({path, surface});
+        decoded.notify_all();
+    }
+}
+
+SDL_Surface* AssetManager::decode(const std::string& path) {
+    SDL_Surface* surface = IMG_Load(path.c_str());
+    if(!surface) {
+        std::cout << "Failed to load image " << path << ": " << IMG_GetError() << std::endl;
+    }
+    return surface;
+}
+
+void AssetManager::createTextures(std::vector<Decoded>& ready, bool ownsSurfaces) {
+    // Файл могли отпустить, пока он декодировался
+    size_t kept = 0;
+    for(auto& result : ready) {
+        auto it = assets.find(result.path);
+        if(it != assets.end() && it->second.pending && result.surface) {
+            ready[kept++] = result;
+        } else {
+            if(it != assets.end()) it->second.pending = false;
+            if(result.surface && ownsSurfaces) SDL_FreeSurface(result.surface);
+        }
+    }
+    ready.resize(kept);
+    if(ready.empty()) return;
+
+    // Одна задача рендера на все готовые файлы
+    std::vector<SDL_Texture*> textures(ready.size(), nullptr);
+    renderQueue->run([&] {
+        for(size_t i = 0; i < ready.size(); i++) {
+            textures[i] = SDL_CreateTextureFromSurface(renderer, ready[i].surface);
+        }
+    });
+
+    for(size_t i = 0; i < ready.size(); i++) {
+        TextureAsset& asset = assets[ready[i].path];
+        asset.pending = false;
+        if(textures[i]) {
+            setTexture(asset, textures[i], ready[i].surface->w, ready[i].surface->h);
+        } else {
+            std::cout << "Failed to create texture from image: " << SDL_GetError() << std::endl;
+        }
+        if(ownsSurfaces) SDL_FreeSurface(ready[i].surface);
+    }
+}
+
+void AssetManager::setTexture(TextureAsset& asset, SDL_Texture* texture, int width, int height) {
+    if(asset.texture) {
+        renderQueue->destroyTexture(asset.texture);
+        stats.textures--;
+        stats.bytes -= static_cast<size_t>(asset.width) * asset.height * 4;
+    }
+    asset.texture = texture;
+    asset.width = width;
+    asset.height = height;
+    if(texture) {
+        stats.textures++;
+        stats.bytes += static_cast<size_t>(width) * height * 4;
+        stats.peakBytes = std::max(stats.peakBytes, stats.bytes);
+    }
+}
@@ -0,0 +1,136 @@
+#ifndef AssetManager_hpp
+#define AssetManager_hpp
+
+#include "SDL2/SDL.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class AssetManager;
+class RenderQueue;
+
+// Запись кэша текстур; живет, пока на нее есть ссылки
+struct TextureAsset {
+    std::string path;       // Канонический путь, ключ кэша
+    int refs = 0;
+    bool pending = false;   // Файл еще декодируется фоновым потоком
+    SDL_Texture* texture = nullptr;
+    int width = 0;
+    int height = 0;
+};
+
+// Ссылка на текстуру из AssetManager: копия добавляет ссылку, уничтожение отпускает.
+// Как и сам менеджер, используется только из потока симуляции (и до его запуска)
+class TextureHandle {
+public:
+    TextureHandle() = default;
+    TextureHandle(const TextureHandle& other) : owner(other.owner), asset(other.asset) {
+        if(asset) asset->refs++;
+    }
+    TextureHandle(TextureHandle&& other) noexcept : owner(other.owner), asset(other.asset) {
+        other.owner = nullptr;
+        other.asset = nullptr;
+    }
+    TextureHandle& operator=(TextureHandle other) noexcept {
+        // Новая ссылка берется раньше, чем отпускается старая
+        std::swap(owner, other.owner);
+        std::swap(asset, other.asset);
+        return *this;
+    }
+    ~TextureHandle() { reset(); }
+
+    void reset();
+    // nullptr, пока файл декодируется или если он не загрузился
+    SDL_Texture* get() const { return asset ? asset->texture : nullptr; }
+    int getWidth() const { return asset ? asset->width : 0; }
+    int getHeight() const { return asset ? asset->height : 0; }
+    explicit operator bool() const { return get() != nullptr; }
+
+private:
+    friend class AssetManager;
+    TextureHandle(AssetManager* owner, TextureAsset* asset) : owner(owner), asset(asset) {}
+
+    AssetManager* owner = nullptr;
+    TextureAsset* asset = nullptr;
+};
+
+// Общий кэш текстур игры по каноническому пути со счетчиком ссылок.
+// Сцена берет ссылки на новые ресурсы раньше, чем отпускает старые, поэтому
+// общие для сцен картинки переживают переход и не декодируются заново.
+// Файлы для preload декодируются фоновым потоком, текстуры создаются пачкой через очередь рендера.
+// Текстура без ссылок удаляется с отложенным SDL_DestroyTexture: она может быть в снимках рендера.
+class AssetManager {
+public:
+    struct Stats {
+        size_t hits = 0;       // Запрос нашел текстуру в кэше
+        size_t misses = 0;     // Файл пришлось читать
+        size_t textures = 0;   // Живые текстуры
+        size_t bytes = 0;      // Оценка памяти текстур: 4 байта на пиксель
+        size_t peakBytes = 0;
+    };
+
+    AssetManager(SDL_Renderer* renderer, RenderQueue* renderQueue);
+    ~AssetManager();
+    AssetManager(const AssetManager&) = delete;
+    AssetManager& operator=(const AssetManager&) = delete;
+
+    // Текстура, готовая к использованию; пустая ссылка, если файл не загрузился.
+    // decoded - картинка, уже прочитанная вызывающим (нужна ему самому), используется при промахе
+    // и не освобождается
+    TextureHandle load(const std::string& path, SDL_Surface* decoded = nullptr);
+    // Ссылка сразу, файл декодируется в фоне
+    TextureHandle preload(const std::string& path);
+    // Текстура предзагруженной ссылки: если файл еще декодируется, ждет только его
+    SDL_Texture* get(const TextureHandle& handle);
+
+    // Забирает декодированные в фоне файлы и создает их текстуры; вызывается каждый тик
+    void collect();
+
+    // Горячая перезагрузка: читает файл заново, ссылки видят новую текстуру.
+    // false, если такого файла в кэше нет
+    bool reload(const std::string& path);
+
+    const Stats& getStats() const { return stats; }
+    void printStats(std::ostream& out) const;
+
+private:
+    friend class TextureHandle;
+
+    struct Decoded {
+        std::string path;
+        SDL_Surface* surface;
+    };
+
+    SDL_Renderer* renderer;
+    RenderQueue* renderQueue;
+    std::unordered_map<std::string, TextureAsset> assets;
+    Stats stats;
+
+    // Общие с фоновым потоком
+    std::mutex mutex;
+    std::condition_variable wake;     // Новое задание или остановка
+    std::condition_variable decoded;  // Новый результат
+    std::deque<std::string> jobs;
+    std::vector<Decoded> results;
+    bool stopping = false;
+    std::thread worker;
+
+    static std::string canonicalPath(const std::string& path);
+    // Запись с добавленной ссылкой; created - файла в кэше не было
+    TextureAsset* acquire(const std::string& path, bool& created);
+    void release(TextureAsset* asset);
+    void finish(TextureAsset& asset);
+    void workerLoop();
+    static SDL_Surface* decode(const std::string& path);
+    // Создает текстуры в потоке рендера; ownsSurfaces - освободить поверхности после
+    void createTextures(std::vector<Decoded>& ready, bool ownsSurfaces);
+    void setTexture(TextureAsset& asset, SDL_Texture* texture, int width, int height);
+};
+
+#endif
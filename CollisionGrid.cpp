@@ -0,0 +1,61 @@
+#include "CollisionGrid.hpp"
+#include <algorithm>
+
+CollisionGrid::CollisionGrid() : rows(0), cols(0), wordsPerRow(0), version(0) {}
+
+bool CollisionGrid::parseLayer(const std::string& name, CollisionLayer& layer) {
+    if(name == "solid") layer = CollisionLayer::Solid;
+    else if(name == "water") layer = CollisionLayer::Water;
+    else if(name == "trigger") layer = CollisionLayer::Trigger;
+    else return false;
+    return true;
+}
+
+void CollisionGrid::resize(int newRows, int newCols) {
+    newRows = std::max(newRows, 0);
+    newCols = std::max(newCols, 0);
+    if(newRows == rows && newCols == cols) return;
+
+    int newWords = (newCols + 63) / 64;
+    for(auto& plane : planes) {
+        std::vector<uint64_t> resized(static_cast<size_t>(newRows) * newWords, 0);
+        int keepRows = std::min(rows, newRows);
+        int keepWords = std::min(wordsPerRow, newWords);
+        for(int row = 0; row < keepRows; row++) {
+            std::copy_n(&plane[row * wordsPerRow], keepWords, &resized[row * newWords]);
+        }
+        // Отрезаем биты за новой правой границей
+        if(newCols < cols && newCols % 64 != 0 && keepWords == newWords) {
+            uint64_t mask = (uint64_t(1) << (newCols % 64)) - 1;
+            for(int row = 0; row < keepRows; row++) {
+                resized[row * newWords + newWords - 1] &= mask;
+            }
+        }
+        plane.swap(resized);
+    }
+
+    rows = newRows;
+    cols = newCols;
+    wordsPerRow = newWords;
+    version++;
+}
+
+void CollisionGrid::clear() {
+    for(auto& plane : planes) {
+        std::fill(plane.begin(), plane.end(), 0);
+    }
+    version++;
+}
+
+void CollisionGrid::set(int row, int col, CollisionLayer layer, bool value) {
+    if(row < 0 || row >= rows || col < 0 || col >= cols) return;
+
+    uint64_t& word = planes[static_cast<int>(layer)][row * wordsPerRow + (col >> 6)];
+    const uint64_t bit = uint64_t(1) << (col & 63);
+    if(value) {
+        word |= bit;
+    } else {
+        word &= ~bit;
+    }
+    version++;
+}
@@ -0,0 +1,77 @@
+#ifndef CollisionGrid_hpp
+#define CollisionGrid_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Слои коллизий, каждый хранится отдельной битовой плоскостью
+enum class CollisionLayer : uint8_t {
+    Solid = 0,
+    Water = 1,
+    Trigger = 2
+};
+
+// Сетка коллизий: по одному биту на клетку, строки выровнены по 64-битным словам.
+// Проверка и изменение клетки - O(1), без поиска и аллокаций.
+class CollisionGrid {
+public:
+    static const int LAYER_COUNT = 3;
+
+    static uint32_t layerBit(CollisionLayer layer) { return 1u << static_cast<uint32_t>(layer); }
+    static bool parseLayer(const std::string& name, CollisionLayer& layer);
+
+    CollisionGrid();
+
+    // Меняет размер, сохраняя уже выставленные клетки
+    void resize(int newRows, int newCols);
+    void clear();
+
+    bool test(int row, int col, CollisionLayer layer) const {
+        if(row < 0 || row >= rows || col < 0 || col >= cols) return false;
+        const uint64_t word = planes[static_cast<int>(layer)][row * wordsPerRow + (col >> 6)];
+        return (word >> (col & 63)) & 1u;
+    }
+
+    // Есть ли в клетке хотя бы один слой из маски (см. layerBit)
+    bool testAny(int row, int col, uint32_t layerMask) const {
+        for(int layer = 0; layer < LAYER_COUNT; layer++) {
+            if((layerMask & (1u << layer)) && test(row, col, static_cast<CollisionLayer>(layer))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void set(int row, int col, CollisionLayer layer, bool value);
+
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    // Растет при каждом изменении, чтобы зависимые кэши знали, когда пересчитываться
+    uint64_t getVersion() const { return version; }
+
+    // Обходит только выставленные клетки слоя, пропуская пустые слова целиком
+    template<typename Callback>
+    void forEachSet(CollisionLayer layer, Callback callback) const {
+        const auto& plane = planes[static_cast<int>(layer)];
+        for(int row = 0; row < rows; row++) {
+            for(int w = 0; w < wordsPerRow; w++) {
+                uint64_t word = plane[row * wordsPerRow + w];
+                while(word) {
+                    int bit = __builtin_ctzll(word);
+                    callback(row, w * 64 + bit);
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+
+private:
+    int rows;
+    int cols;
+    int wordsPerRow;
+    uint64_t version;
+    std::vector<uint64_t> planes[LAYER_COUNT];
+};
+
+#endif
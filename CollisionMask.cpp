@@ -0,0 +1,126 @@
+#include "CollisionMask.hpp"
+#include <algorithm>
+#include <iostream>
+
+CollisionMask::CollisionMask() : width(0), height(0), wordsPerRow(0), coarseWordsPerRow(0) {}
+
+void CollisionMask::clear() {
+    width = 0;
+    height = 0;
+    wordsPerRow = 0;
+    coarseWordsPerRow = 0;
+    bits.clear();
+    coarse.clear();
+}
+
+bool CollisionMask::build(SDL_Surface* surface, Uint8 threshold) {
+    clear();
+    if(!surface) return false;
+
+    // Приводим к RGBA32, чтобы альфа всегда была 4-м байтом пикселя
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    if(!converted) {
+        std::cout << "Failed to convert collision mask surface: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    width = converted->w;
+    height = converted->h;
+    wordsPerRow = (width + 63) / 64;
+    bits.assign(static_cast<size_t>(height) * wordsPerRow, 0);
+
+    if(SDL_MUSTLOCK(converted)) {
+        SDL_LockSurface(converted);
+    }
+    const Uint8* pixels = static_cast<const Uint8*>(converted->pixels);
+    for(int y = 0; y < height; y++) {
+        const Uint8* row = pixels + static_cast<size_t>(y) * converted->pitch;
+        uint64_t* out = &bits[static_cast<size_t>(y) * wordsPerRow];
+        for(int x = 0; x < width; x++) {
+            if(row[x * 4 + 3] >= threshold) {
+                out[x >> 6] |= uint64_t(1) << (x & 63);
+            }
+        }
+    }
+    if(SDL_MUSTLOCK(converted)) {
+        SDL_UnlockSurface(converted);
+    }
+    SDL_FreeSurface(converted);
+
+    buildCoarse();
+    return true;
+}
+
+bool CollisionMask::anyBit(const uint64_t* row, int first, int last) {
+    const int firstWord = first >> 6;
+    const int lastWord = last >> 6;
+    for(int w = firstWord; w <= lastWord; w++) {
+        uint64_t word = row[w];
+        if(w == firstWord) word &= ~uint64_t(0) << (first & 63);
+        if(w == lastWord) word &= ~uint64_t(0) >> (63 - (last & 63));
+        if(word) return true;
+    }
+    return false;
+}
+
+bool CollisionMask::testRow(int y, int x0, int x1) const {
+    if(y < 0 || y >= height) return false;
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, width - 1);
+    if(x0 > x1) return false;
+    return anyBit(&bits[static_cast<size_t>(y) * wordsPerRow], x0, x1);
+}
+
+bool CollisionMask::testRect(int x0, int y0, int x1, int y1) const {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, width - 1);
+    y1 = std::min(y1, height - 1);
+    if(x0 > x1 || y0 > y1) return false;
+
+    const int blockSize = 1 << BLOCK_SHIFT;
+    for(int by = y0 >> BLOCK_SHIFT; by <= y1 >> BLOCK_SHIFT; by++) {
+        if(!anyBit(&coarse[static_cast<size_t>(by) * coarseWordsPerRow], x0 >> BLOCK_SHIFT, x1 >> BLOCK_SHIFT)) {
+            continue;
+        }
+        const int rowEnd = std::min(y1, by * blockSize + blockSize - 1);
+        for(int y = std::max(y0, by * blockSize); y <= rowEnd; y++) {
+            if(anyBit(&bits[static_cast<size_t>(y) * wordsPerRow], x0, x1)) return true;
+        }
+    }
+    return false;
+}
+
+bool CollisionMask::testColumn(int x, int y0, int y1) const {
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, height - 1);
+    for(int y = y0; y <= y1; y++) {
+        if(test(x, y)) return true;
+    }
+    return false;
+}
+
+void CollisionMask::buildCoarse() {
+    const int blockSize = 1 << BLOCK_SHIFT;
+    const int coarseCols = (width + blockSize - 1) >> BLOCK_SHIFT;
+    const int coarseRows = (height + blockSize - 1) >> BLOCK_SHIFT;
+    coarseWordsPerRow = (coarseCols + 63) / 64;
+    coarse.assign(static_cast<size_t>(coarseRows) * coarseWordsPerRow, 0);
+
+    // Блок помечается, если в нем есть хотя бы один твердый пиксель.
+    // 64-битное слово маски покрывает ровно 8 блоков по горизонтали.
+    for(int y = 0; y < height; y++) {
+        const uint64_t* row = &bits[static_cast<size_t>(y) * wordsPerRow];
+        uint64_t* out = &coarse[static_cast<size_t>(y >> BLOCK_SHIFT) * coarseWordsPerRow];
+        for(int w = 0; w < wordsPerRow; w++) {
+            uint64_t word = row[w];
+            while(word) {
+                int block = (w * 64 + __builtin_ctzll(word)) >> BLOCK_SHIFT;
+                out[block >> 6] |= uint64_t(1) << (block & 63);
+                // Остаток блока уже учтен, сразу переходим к следующему
+                int next = ((block + 1) << BLOCK_SHIFT) - w * 64;
+                word = next >= 64 ? 0 : word & (~uint64_t(0) << next);
+            }
+        }
+    }
+}
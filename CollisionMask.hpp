@@ -0,0 +1,62 @@
+#ifndef CollisionMask_hpp
+#define CollisionMask_hpp
+
+#include "SDL2/SDL.h"
+#include <cstdint>
+#include <vector>
+
+// Попиксельная маска коллизий: 1 бит на пиксель, строки выровнены по 64-битным словам.
+// Строится один раз при загрузке сцены из альфа-канала слоя или отдельной картинки-маски.
+// Поверх лежит грубая сетка (1 бит на блок 8x8), по которой пустые области отсекаются
+// без обращения к полной маске.
+class CollisionMask {
+public:
+    static const int BLOCK_SHIFT = 3;  // Размер блока грубой сетки: 1 << BLOCK_SHIFT пикселей
+
+    CollisionMask();
+
+    // Пиксель считается твердым, если его альфа не меньше threshold
+    bool build(SDL_Surface* surface, Uint8 threshold);
+    void clear();
+
+    bool test(int x, int y) const {
+        // Отрицательные координаты после приведения к unsigned тоже отсекаются
+        if(static_cast<unsigned>(x) >= static_cast<unsigned>(width) ||
+           static_cast<unsigned>(y) >= static_cast<unsigned>(height)) {
+            return false;
+        }
+        const int bx = x >> BLOCK_SHIFT;
+        const int by = y >> BLOCK_SHIFT;
+        if(!((coarse[by * coarseWordsPerRow + (bx >> 6)] >> (bx & 63)) & 1u)) {
+            return false;
+        }
+        return (bits[y * wordsPerRow + (x >> 6)] >> (x & 63)) & 1u;
+    }
+
+    // Есть ли твердый пиксель на отрезке строки [x0, x1] или столбца [y0, y1].
+    // Строка проверяется словами по 64 пикселя, а не попиксельно.
+    bool testRow(int y, int x0, int x1) const;
+    bool testColumn(int x, int y0, int y1) const;
+    // Есть ли твердый пиксель в прямоугольнике [x0, x1] x [y0, y1].
+    // Строки блока проверяются, только если грубая сетка отмечает в нем что-то твердое
+    bool testRect(int x0, int y0, int x1, int y1) const;
+
+    bool empty() const { return width == 0 || height == 0; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    int width;
+    int height;
+    int wordsPerRow;
+    std::vector<uint64_t> bits;
+
+    int coarseWordsPerRow;
+    std::vector<uint64_t> coarse;
+
+    void buildCoarse();
+    // Есть ли отмеченный бит в [first, last] строки битов
+    static bool anyBit(const uint64_t* row, int first, int last);
+};
+
+#endif
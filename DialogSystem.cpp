@@ -1,22 +1,31 @@
 #include "DialogSystem.hpp"
+#include "RenderQueue.hpp"
 #include <iostream>
+#include <algorithm>
 
-DialogSystem::DialogSystem(SDL_Renderer* renderer, const std::string& gamePath) 
+DialogSystem::DialogSystem(SDL_Renderer* renderer, const std::string& gamePath, RenderQueue* renderQueue,
+                           AssetManager* assets)
     : renderer(renderer),
+      renderQueue(renderQueue),
+      assets(assets),
       gamePath(gamePath),  // Сохраняем путь к игре
-      dialogBox(nullptr),
       boxHeight(250),
+      screenWidth(800),
+      screenHeight(600),
       active(false), 
       currentY(600),
+      previousY(600),
       targetY(600),
       animationSpeed(1000.0f), 
       state(DialogState::Hidden),
       currentGroup(nullptr),
       currentLineIndex(0),
       textTimer(0),
-      charDelay(0.05f),
-      instantPrint(false),
-      font(nullptr),
+      previousTextTimer(0),
+      revealDelay(0),
+      lineGlyphs(0),
+      groupSerial(0),
+      layoutSerial(0),
       fontSize(36),  // Изменили с 32 на 36 для основного текста
       textColor{255, 255, 255, 255},
       titleColor{255, 200, 0, 255},
@@ -32,100 +41,120 @@ DialogSystem::DialogSystem(SDL_Renderer* renderer, const std::string& gamePath)
 }
 
 DialogSystem::~DialogSystem() {
-    if(dialogBox) {
-        SDL_DestroyTexture(dialogBox);
-    }
-    if(font) {
-        TTF_CloseFont(font);
-    }
+    // Шрифты атласов закрываются до TTF_Quit
+    titleFont.close();
+    textFont.close();
     TTF_Quit();
 }
 
 void DialogSystem::loadDialogBox(const std::string& path) {
-    SDL_Surface* surface = IMG_Load(path.c_str());
-    if(surface) {
-        dialogBox = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_FreeSurface(surface);
-    }
+    dialogBox = assets->load(path);
 }
 
 void DialogSystem::initializeFont(const std::string& gamePath) {
     std::string fontPath = gamePath + "/font/Mcg.ttf"; // Изменено на Mcg.ttf
-    font = TTF_OpenFont(fontPath.c_str(), fontSize);
-    if(!font) {
-        std::cout << "Failed to load font! SDL_ttf Error: " << TTF_GetError() << std::endl;
+    // Заголовок на 12 пикселей больше основного текста. При ошибке остается прежний шрифт
+    titleFont.open(renderer, fontPath, fontSize + 12);
+    textFont.open(renderer, fontPath, fontSize);
+    layoutSerial = 0;  // Раскладки ссылаются на страницы старых атласов, groupSerial всегда больше 0
+}
+
+void DialogSystem::captureRenderState(DialogRenderState& state) const {
+    state.active = active;
+    state.y = currentY;
+    state.previousY = previousY;
+    state.screenWidth = screenWidth;
+    // Текстура берется при каждом снимке: горячая перезагрузка меняет ее в менеджере
+    state.box = dialogBox.get();
+    state.hasLine = active && currentGroup && currentLineIndex < currentGroup->lines.size();
+    if(state.hasLine) {
+        const auto& line = currentGroup->lines[currentLineIndex];
+        state.avatar = line.avatarTexture;
+        state.title = line.title;
+        state.text = line.text;
+        state.groupSerial = groupSerial;
+        state.lineIndex = static_cast<uint32_t>(currentLineIndex);
+        state.revealTime = textTimer;
+        state.previousRevealTime = previousTextTimer;
+        state.revealDelay = revealDelay;
+    } else {
+        state.avatar = nullptr;
     }
 }
 
-void DialogSystem::render() {
-    if(!active) return;
+void DialogSystem::render(const DialogRenderState& state, float alpha) {
+    if(!state.active) return;
+
+    const int y = static_cast<int>(state.previousY + (state.y - state.previousY) * alpha);
 
     // Рендерим диалоговое окно
-    SDL_Rect dstRect = {0, static_cast<int>(currentY), 800, boxHeight};
-    SDL_RenderCopy(renderer, dialogBox, nullptr, &dstRect);
+    SDL_Rect dstRect = {0, y, state.screenWidth, boxHeight};
+    SDL_RenderCopy(renderer, state.box, nullptr, &dstRect);
 
     // Рендерим текст и аватар
-    if(currentGroup && currentLineIndex < currentGroup->lines.size()) {
-        const auto& line = currentGroup->lines[currentLineIndex];
-        
+    if(state.hasLine) {
         // Сначала рендерим аватар, чтобы он был под текстом
-        if(line.avatarTexture) {
+        if(state.avatar) {
             SDL_Rect avatarRect = {
-                800 - AVATAR_SIZE - 20,  // 20 пикселей отступ справа
-                static_cast<int>(currentY) - AVATAR_SIZE/2,  // Половина аватара выше окна
+                state.screenWidth - AVATAR_SIZE - 20,  // 20 пикселей отступ справа
+                y - AVATAR_SIZE/2,  // Половина аватара выше окна
                 AVATAR_SIZE,
                 AVATAR_SIZE
             };
-            SDL_RenderCopy(renderer, line.avatarTexture, nullptr, &avatarRect);
+            SDL_RenderCopy(renderer, state.avatar, nullptr, &avatarRect);
         }
         
-        renderText();
+        renderText(state, y, alpha);
     }
 }
 
-void DialogSystem::renderText() {
-    if(!font || !currentGroup || currentLineIndex >= currentGroup->lines.size()) return;
+const DialogSystem::LineLayout& DialogSystem::getLineLayout(const DialogRenderState& state) {
+    if(state.groupSerial != layoutSerial) {
+        lineLayouts.clear();
+        layoutSerial = state.groupSerial;
+    }
+    if(lineLayouts.size() <= state.lineIndex) {
+        lineLayouts.resize(state.lineIndex + 1);
+    }
 
-    const auto& line = currentGroup->lines[currentLineIndex];
-    
-    // Устанавливаем размер шрифта для заголовка на 12 пикселей больше основного
-    TTF_SetFontSize(font, fontSize + 12);
-    
-    // Рендерим заголовок
-    SDL_Surface* titleSurface = TTF_RenderText_Blended(font, line.title.c_str(), titleColor);
-    if(titleSurface) {
-        SDL_Texture* titleTexture = SDL_CreateTextureFromSurface(renderer, titleSurface);
-        SDL_Rect titleRect = {
-            textPadding, 
-            static_cast<int>(currentY) + textPadding,
-            titleSurface->w,
-            titleSurface->h
-        };
-        SDL_RenderCopy(renderer, titleTexture, nullptr, &titleRect);
-        SDL_FreeSurface(titleSurface);
-        SDL_DestroyTexture(titleTexture);
-    }
-
-    // Возвращаем размер шрифта для основного текста
-    TTF_SetFontSize(font, fontSize);
-    
-    // Рендерим текст
-    SDL_Surface* textSurface = TTF_RenderText_Blended(font, line.displayedText.c_str(), textColor);
-    if(textSurface) {
-        SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-        SDL_Rect textRect = {
-            textPadding,
-            static_cast<int>(currentY) + textPadding + fontSize + 15, // Увеличили отступ между заголовком и текстом с 10 до 15
-            textSurface->w,
-            textSurface->h
-        };
-        SDL_RenderCopy(renderer, textTexture, nullptr, &textRect);
-        SDL_FreeSurface(textSurface);
-        SDL_DestroyTexture(textTexture);
+    // Текст переносится по ширине окна; строка с аватаром не заходит под него
+    int wrapWidth = state.screenWidth - 2 * textPadding;
+    if(state.avatar) wrapWidth -= AVATAR_SIZE + 20;
+    wrapWidth = std::max(wrapWidth, 1);
+
+    LineLayout& line = lineLayouts[state.lineIndex];
+    if(!line.ready || line.wrapWidth != wrapWidth) {
+        titleFont.layout(state.title, line.title, wrapWidth);
+        textFont.layout(state.text, line.text, wrapWidth);
+        line.wrapWidth = wrapWidth;
+        line.ready = true;
+    }
+    return line;
+}
+
+void DialogSystem::renderText(const DialogRenderState& state, int y, float alpha) {
+    // Строка раскладывается один раз за показ группы; дальше кадр только рисует префикс
+    const LineLayout& layout = getLineLayout(state);
+    const TextLayout& titleLayout = layout.title;
+    const TextLayout& textLayout = layout.text;
+
+    // Время печати интерполируется между тиками, как и положение окна
+    size_t visible = textLayout.glyphs.size();
+    if(state.revealDelay > 0.0f) {
+        const float time = state.previousRevealTime + (state.revealTime - state.previousRevealTime) * alpha;
+        visible = std::min(visible, static_cast<size_t>(time / state.revealDelay));
     }
+
+    titleFont.draw(titleLayout, static_cast<float>(textPadding), static_cast<float>(y + textPadding),
+                   titleLayout.glyphs.size(), titleColor);
+    // Отступ между заголовком и текстом - 15 пикселей
+    textFont.draw(textLayout, static_cast<float>(textPadding),
+                  static_cast<float>(y + textPadding + fontSize + 15), visible, textColor);
 }
 
 void DialogSystem::update(float deltaTime) {
+    previousY = currentY;
+    previousTextTimer = textTimer;
     if(!active) return;
 
     updateAnimation(deltaTime);
@@ -144,8 +173,8 @@ void DialogSystem::updateAnimation(float deltaTime) {
     }
     else if(state == DialogState::Closing) {
         currentY += animationSpeed * deltaTime;
-        if(currentY >= 600) {
-            currentY = 600;
+        if(currentY >= screenHeight) {
+            currentY = screenHeight;
             state = DialogState::Hidden;
             active = false;
             currentLineIndex = 0;
@@ -157,31 +186,42 @@ void DialogSystem::updateAnimation(float deltaTime) {
 void DialogSystem::updateTextPrinting(float deltaTime) {
     if(!currentGroup || currentLineIndex >= currentGroup->lines.size()) return;
 
-    auto& line = currentGroup->lines[currentLineIndex];
-    if(instantPrint) {
-        line.displayedText = line.text;
-        instantPrint = false;
-        return;
-    }
+    // Время печати не ограничено тиком: за длинный тик появляется несколько символов
+    const float duration = revealDelay * lineGlyphs;
+    textTimer = std::min(textTimer + deltaTime, duration);
+}
 
-    if(line.displayedText.length() < line.text.length()) {
-        textTimer += deltaTime;
-        // Вычисляем задержку символа на основе длины текста и желаемой продолжительности
-        float charDelay = line.animDuration / line.text.length();
-        if(textTimer >= charDelay) {
-            textTimer = 0;
-            line.displayedText += line.text[line.displayedText.length()];
-        }
+void DialogSystem::beginLine() {
+    textTimer = previousTextTimer = 0.0f;
+    lineGlyphs = 0;
+    revealDelay = 0.0f;
+    if(!currentGroup || currentLineIndex >= currentGroup->lines.size()) return;
+
+    const auto& line = currentGroup->lines[currentLineIndex];
+    size_t pos = 0;
+    Uint32 codepoint;
+    while(nextCodepoint(line.text, pos, codepoint)) {
+        lineGlyphs++;
+    }
+    // Задержка символа из длины текста и желаемой продолжительности печати
+    if(lineGlyphs > 0) {
+        revealDelay = line.animDuration / lineGlyphs;
     }
 }
 
+size_t DialogSystem::revealedGlyphs() const {
+    if(revealDelay <= 0.0f) return lineGlyphs;
+    // Погрешность float не должна прятать последний символ, когда время печати вышло
+    return std::min(lineGlyphs, static_cast<size_t>(textTimer / revealDelay + 1e-4f));
+}
+
 void DialogSystem::handleInput(bool useKeyPressed) {
     if(!active || state != DialogState::Stable) return;
 
     if(useKeyPressed) {
-        const auto& line = currentGroup->lines[currentLineIndex];
-        if(line.displayedText.length() < line.text.length()) {
-            instantPrint = true;
+        if(revealedGlyphs() < lineGlyphs) {
+            // Допечатываем строку сразу
+            textTimer = previousTextTimer = revealDelay * lineGlyphs;
         } else {
             nextLine();
         }
@@ -195,8 +235,7 @@ void DialogSystem::nextLine() {
     if(currentLineIndex >= currentGroup->lines.size()) {
         close();
     } else {
-        currentGroup->lines[currentLineIndex].displayedText = "";
-        textTimer = 0;
+        beginLine();
     }
 }
 
@@ -205,47 +244,114 @@ void DialogSystem::showDialog(const std::string& dialogGroupName) {
 
     active = true;
     state = DialogState::Opening;
-    targetY = 600 - boxHeight;
-    currentY = 600;
+    targetY = screenHeight - boxHeight;
+    currentY = previousY = screenHeight;
 }
 
 void DialogSystem::setCurrentGroup(const DialogGroup* group) {
     cleanupAvatars();
     currentGroup = const_cast<DialogGroup*>(group);
     currentLineIndex = 0;
-    if(group && !group->lines.empty()) {
+    groupSerial++;
+    if(group) {
+        // Аватары предзагружены вместе со сценой, диск здесь не читается
         for(auto& line : currentGroup->lines) {
-            loadAvatar(line, gamePath);
+            auto avatar = sceneAvatars.find(line.avatar);
+            if(avatar != sceneAvatars.end()) line.avatarTexture = assets->get(avatar->second);
         }
-        currentGroup->lines[0].displayedText = "";
+    }
+    beginLine();
+}
+
+DialogSystem::Snapshot DialogSystem::getSnapshot() const {
+    Snapshot snapshot;
+    snapshot.group = currentGroup;
+    snapshot.line = static_cast<uint32_t>(currentLineIndex);
+    snapshot.textTimer = textTimer;
+    snapshot.currentY = currentY;
+    snapshot.targetY = targetY;
+    snapshot.state = static_cast<uint8_t>(state);
+    snapshot.active = active;
+    return snapshot;
+}
+
+void DialogSystem::restoreSnapshot(const Snapshot& snapshot) {
+    if(snapshot.group != currentGroup) {
+        setCurrentGroup(snapshot.group);
+    }
+    currentLineIndex = snapshot.line;
+    beginLine();
+    textTimer = previousTextTimer = snapshot.textTimer;
+    currentY = previousY = snapshot.currentY;
+    targetY = snapshot.targetY;
+    state = static_cast<DialogState>(snapshot.state);
+    active = snapshot.active;
+}
+
+void DialogSystem::setViewport(int width, int height) {
+    screenWidth = width;
+    screenHeight = height;
+
+    // Переносим окно к новому нижнему краю, сохраняя текущее состояние анимации
+    switch(state) {
+        case DialogState::Hidden:
+            currentY = targetY = screenHeight;
+            previousY = currentY;
+            break;
+        case DialogState::Opening:
+            targetY = screenHeight - boxHeight;
+            currentY = std::min(currentY, static_cast<float>(screenHeight));
+            break;
+        case DialogState::Stable:
+            currentY = targetY = screenHeight - boxHeight;
+            previousY = currentY;
+            break;
+        case DialogState::Closing:
+            targetY = screenHeight;
+            currentY = std::max(currentY, static_cast<float>(screenHeight - boxHeight));
+            break;
     }
 }
 
 void DialogSystem::close() {
     if(state == DialogState::Stable) {
         state = DialogState::Closing;
-        targetY = 600;
+        targetY = screenHeight;
     }
 }
 
-void DialogSystem::cleanupAvatars() {
-    if(currentGroup) {
-        for(auto& line : currentGroup->lines) {
-            if(line.avatarTexture) {
-                SDL_DestroyTexture(line.avatarTexture);
-                line.avatarTexture = nullptr;
-            }
+void DialogSystem::reloadImage(const std::string& imageName) {
+    // Окно берет текстуру из ссылки при каждом снимке, а строкам открытой группы
+    // нужно заново взять указатель на перечитанный аватар
+    auto avatar = sceneAvatars.find(imageName);
+    if(avatar == sceneAvatars.end() || !currentGroup) return;
+    for(auto& line : currentGroup->lines) {
+        if(line.avatar == imageName) line.avatarTexture = assets->get(avatar->second);
+    }
+}
+
+void DialogSystem::preloadAvatars(const std::vector<DialogGroup>& groups) {
+    // Сначала новые ссылки, потом отпускаем старые: общие аватары сцен не перечитываются
+    std::unordered_map<std::string, TextureHandle> avatars;
+    for(const auto& group : groups) {
+        for(const auto& line : group.lines) {
+            if(line.avatar == "none" || avatars.count(line.avatar)) continue;
+            avatars[line.avatar] = assets->preload(gamePath + "/image/" + line.avatar);
         }
     }
+    sceneAvatars.swap(avatars);
 }
 
-void DialogSystem::loadAvatar(DialogLine& line, const std::string& gamePath) {
-    if(line.avatar == "none") return;
-    
-    std::string avatarPath = gamePath + "/image/" + line.avatar;
-    SDL_Surface* surface = IMG_Load(avatarPath.c_str());
-    if(surface) {
-        line.avatarTexture = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_FreeSurface(surface);
+void DialogSystem::reloadFont() {
+    // Атласы пересобираются с новым шрифтом в потоке рендера, между кадрами
+    renderQueue->run([&] { initializeFont(gamePath); });
+}
+
+void DialogSystem::cleanupAvatars() {
+    // Текстурами владеет кэш, строки только перестают на них ссылаться
+    if(currentGroup) {
+        for(auto& line : currentGroup->lines) {
+            line.avatarTexture = nullptr;
+        }
     }
 }
\ No newline at end of file
@@ -4,16 +4,21 @@
 #include "SDL2/SDL.h"
 #include "SDL2/SDL_image.h"
 #include "SDL2/SDL_ttf.h"
+#include "RenderState.hpp"
+#include "GlyphAtlas.hpp"
+#include "AssetManager.hpp"
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+class RenderQueue;
+
 struct DialogLine {
     std::string title;
     std::string text;
     std::string avatar;  // Путь к аватару или "none"
     float animDuration;  // Добавляем время анимации в секундах
-    mutable std::string displayedText;
-    mutable SDL_Texture* avatarTexture;  // Кэшированная текстура аватара
+    mutable SDL_Texture* avatarTexture;  // Текстура из кэша аватаров, пока группа открыта
     
     DialogLine() : avatarTexture(nullptr), animDuration(1.0f) {}
 };
@@ -25,24 +30,57 @@ struct DialogGroup {
 
 class DialogSystem {
 public:
-    DialogSystem(SDL_Renderer* renderer, const std::string& gamePath);
+    // Состояние окна для журнала отката: группа, строка, напечатанная часть и анимация
+    struct Snapshot {
+        const DialogGroup* group = nullptr;
+        uint32_t line = 0;
+        float textTimer = 0.0f;  // Напечатанная часть строки определяется временем печати
+        float currentY = 0.0f;
+        float targetY = 0.0f;
+        uint8_t state = 0;
+        bool active = false;
+
+        bool operator==(const Snapshot& other) const {
+            return group == other.group && line == other.line && textTimer == other.textTimer &&
+                   currentY == other.currentY && targetY == other.targetY &&
+                   state == other.state && active == other.active;
+        }
+        bool operator!=(const Snapshot& other) const { return !(*this == other); }
+    };
+
+    DialogSystem(SDL_Renderer* renderer, const std::string& gamePath, RenderQueue* renderQueue, AssetManager* assets);
     ~DialogSystem();
     void loadDialogBox(const std::string& path);
-    void render();
+    void captureRenderState(DialogRenderState& state) const;
+    void render(const DialogRenderState& state, float alpha);
     void update(float deltaTime);
     void handleInput(bool useKeyPressed);
     void showDialog(const std::string& dialogGroupName);
     void setCurrentGroup(const DialogGroup* group);
+    void setViewport(int width, int height);
     bool isActive() const { return active; }
     bool isAnimating() const { return state == DialogState::Opening || state == DialogState::Closing; }
     bool wasJustClosed() const { return state == DialogState::Hidden && !active; }
+    // Горячая перезагрузка: файл уже перечитан менеджером ресурсов, обновляем аватары открытой группы; шрифт
+    void reloadImage(const std::string& imageName);
+    void reloadFont();
+    // Аватары групп сцены загружаются заранее в фоне; аватары прежней сцены отпускаются
+    void preloadAvatars(const std::vector<DialogGroup>& groups);
+    Snapshot getSnapshot() const;
+    // Группа снимка должна быть жива: журнал сбрасывается при перезагрузке диалогов
+    void restoreSnapshot(const Snapshot& snapshot);
 
 private:
     SDL_Renderer* renderer;
-    SDL_Texture* dialogBox;
+    RenderQueue* renderQueue;
+    AssetManager* assets;
+    TextureHandle dialogBox;
     int boxHeight;
+    int screenWidth;   // Размер области вывода, задается через setViewport
+    int screenHeight;
     bool active;
     float currentY;
+    float previousY;  // Позиция окна на предыдущем тике
     float targetY;
     float animationSpeed;
     std::string gamePath;  // Добавляем путь к игре
@@ -56,23 +94,41 @@ private:
 
     DialogGroup* currentGroup; // Убираем const
     size_t currentLineIndex;
+    // Печать текущей строки: символы появляются по времени, за тик их может появиться несколько
     float textTimer;
-    float charDelay;
-    bool instantPrint;
-    TTF_Font* font;
+    float previousTextTimer;
+    float revealDelay;    // Время на символ: animDuration / число символов
+    size_t lineGlyphs;    // Символов UTF-8 в строке
+    uint64_t groupSerial;
+    // Раскладки строк текущей группы в потоке рендера: считаются при первом показе строки
+    // и живут до смены группы, шрифта или ширины переноса
+    struct LineLayout {
+        bool ready = false;
+        int wrapWidth = 0;
+        TextLayout title;
+        TextLayout text;
+    };
+    std::vector<LineLayout> lineLayouts;
+    uint64_t layoutSerial;
+    // Атласы глифов заголовка и текста, заполняются по мере встречи символов
+    GlyphAtlas titleFont;
+    GlyphAtlas textFont;
     int fontSize;
     SDL_Color textColor;
     SDL_Color titleColor;
     int textPadding;
     static const int AVATAR_SIZE = 212;
+    std::unordered_map<std::string, TextureHandle> sceneAvatars;  // Аватары групп текущей сцены по имени файла
 
     void initializeFont(const std::string& gamePath);
     void updateAnimation(float deltaTime);
     void updateTextPrinting(float deltaTime);
     void nextLine();
+    void beginLine();
+    size_t revealedGlyphs() const;
     void close();
-    void renderText();
-    void loadAvatar(DialogLine& line, const std::string& gamePath);
+    void renderText(const DialogRenderState& state, int y, float alpha);
+    const LineLayout& getLineLayout(const DialogRenderState& state);
     void cleanupAvatars();
 };
 
@@ -0,0 +1,119 @@
+#include "FileWatcher.hpp"
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::~FileWatcher() {
+    stop();
+}
+
+#ifdef __linux__
+
+bool FileWatcher::start(const std::string& rootPath) {
+    stop();
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd < 0) {
+        std::cout << "File watcher: inotify is unavailable" << std::endl;
+        return false;
+    }
+    root = rootPath;
+    addDirectory("");
+    return true;
+}
+
+void FileWatcher::stop() {
+    if(fd >= 0) {
+        close(fd);  // Закрытие снимает все watch
+    }
+    fd = -1;
+    directories.clear();
+}
+
+void FileWatcher::addDirectory(const std::string& relativePath) {
+    const std::string fullPath = relativePath.empty() ? root : root + "/" + relativePath;
+    // Редакторы сохраняют файл записью или переименованием временного файла
+    int wd = inotify_add_watch(fd, fullPath.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+    if(wd < 0) {
+        // Корень может быть не каталогом - тогда следить не за чем
+        if(relativePath.empty()) std::cout << "File watcher: cannot watch " << fullPath << std::endl;
+        return;
+    }
+    directories[wd] = relativePath;
+
+    DIR* dir = opendir(fullPath.c_str());
+    if(!dir) return;
+    while(dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if(name == "." || name == ".." || name[0] == '.') continue;
+        const std::string childPath = relativePath.empty() ? name : relativePath + "/" + name;
+        bool isDirectory = entry->d_type == DT_DIR;
+        if(entry->d_type == DT_UNKNOWN) {
+            // Не все файловые системы заполняют d_type
+            struct stat info;
+            isDirectory = stat((fullPath + "/" + name).c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+        }
+        if(isDirectory) addDirectory(childPath);
+    }
+    closedir(dir);
+}
+
+bool FileWatcher::poll(std::vector<std::string>& changedPaths) {
+    changedPaths.clear();
+    if(fd < 0) return false;
+
+    alignas(inotify_event) char buffer[4096];
+    while(true) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if(length <= 0) break;  // EAGAIN - очередь событий пуста
+
+        for(ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            auto dir = directories.find(event->wd);
+            if(dir == directories.end() || event->len == 0) continue;
+            const std::string name = event->name;
+            if(name[0] == '.') continue;  // Временные файлы редакторов
+            const std::string path = dir->second.empty() ? name : dir->second + "/" + name;
+
+            if(event->mask & IN_ISDIR) {
+                if(event->mask & (IN_CREATE | IN_MOVED_TO)) addDirectory(path);
+                continue;
+            }
+            // Созданный файл еще пишется - ждем IN_CLOSE_WRITE
+            if(!(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) continue;
+            if(std::find(changedPaths.begin(), changedPaths.end(), path) == changedPaths.end()) {
+                changedPaths.push_back(path);
+            }
+        }
+    }
+    return !changedPaths.empty();
+}
+
+#else
+
+bool FileWatcher::start(const std::string& rootPath) {
+    root = rootPath;
+    std::cout << "File watcher: not supported on this platform" << std::endl;
+    return false;
+}
+
+void FileWatcher::stop() {
+}
+
+void FileWatcher::addDirectory(const std::string&) {
+}
+
+bool FileWatcher::poll(std::vector<std::string>& changedPaths) {
+    changedPaths.clear();
+    return false;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef FileWatcher_hpp
+#define FileWatcher_hpp
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Слежение за изменениями файлов игры через inotify (только Linux, на других системах ничего не делает).
+// Каталог отслеживается рекурсивно, новые подкаталоги добавляются на лету.
+// poll() не блокирует и отдает пути относительно корня ("scenes/room.json", "image/bg.png"),
+// изменения одного файла за опрос склеиваются в одну запись.
+class FileWatcher {
+public:
+    FileWatcher() = default;
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool start(const std::string& rootPath);
+    void stop();
+    bool isActive() const { return fd >= 0; }
+
+    // Измененные с прошлого опроса файлы; false, если изменений нет
+    bool poll(std::vector<std::string>& changedPaths);
+
+private:
+    int fd = -1;
+    std::string root;
+    std::unordered_map<int, std::string> directories;  // Дескриптор watch -> каталог относительно root
+
+    void addDirectory(const std::string& relativePath);
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include "FramePacer.hpp"
+
+FramePacer::FramePacer() : period(0.0), nextFrame(0.0) {}
+
+void FramePacer::setRate(double hz) {
+    period = hz > 0.0 ? 1.0 / hz : 0.0;
+    nextFrame = now() + period;
+}
+
+double FramePacer::now() {
+    static const double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+    return static_cast<double>(SDL_GetPerformanceCounter()) / frequency;
+}
+
+void FramePacer::sleepUntil(double deadline) {
+    double remaining = deadline - now();
+    if(remaining > SPIN_THRESHOLD) {
+        SDL_Delay(static_cast<Uint32>((remaining - SPIN_THRESHOLD) * 1000.0));
+    }
+    while(now() < deadline) {
+        // Докручиваем остаток, чтобы не зависеть от точности планировщика
+    }
+}
+
+void FramePacer::wait() {
+    if(period <= 0.0) return;
+
+    sleepUntil(nextFrame);
+
+    // Дедлайны идут с фиксированным шагом; если сильно отстали - не пытаемся догонять
+    nextFrame += period;
+    double current = now();
+    if(current > nextFrame) {
+        nextFrame = current + period;
+    }
+}
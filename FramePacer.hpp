@@ -0,0 +1,28 @@
+#ifndef FramePacer_hpp
+#define FramePacer_hpp
+
+#include "SDL2/SDL.h"
+
+// Точное ожидание по SDL_GetPerformanceCounter.
+// SDL_Delay дает погрешность в миллисекунды, поэтому основную часть времени спим,
+// а последние SPIN_THRESHOLD секунд докручиваем активным ожиданием.
+class FramePacer {
+public:
+    FramePacer();
+
+    // Частота кадров в Гц, 0 - без ограничения
+    void setRate(double hz);
+    // Ждет начала следующего кадра, держа ровный шаг между кадрами
+    void wait();
+
+    static double now();
+    static void sleepUntil(double deadline);
+
+private:
+    static constexpr double SPIN_THRESHOLD = 0.002;
+
+    double period;
+    double nextFrame;
+};
+
+#endif
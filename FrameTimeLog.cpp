@@ -0,0 +1,63 @@
+#include "FrameTimeLog.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+
+void FrameTimeLog::enable(const std::string& logPath) {
+    path = logPath;
+    // Час игры при 40 тиках и 60 кадрах в секунду - без перераспределений
+    ticks.reserve(40 * 3600);
+    frames.reserve(60 * 3600);
+    intervals.reserve(60 * 3600);
+}
+
+void FrameTimeLog::addTick(double seconds) {
+    ticks.push_back(static_cast<float>(seconds * 1000.0));
+}
+
+void FrameTimeLog::addFrame(double frameStart, double renderSeconds) {
+    frames.push_back(static_cast<float>(renderSeconds * 1000.0));
+    intervals.push_back(lastFrameStart > 0.0 ? static_cast<float>((frameStart - lastFrameStart) * 1000.0) : 0.0f);
+    lastFrameStart = frameStart;
+}
+
+bool FrameTimeLog::write() const {
+    if(!isEnabled()) return false;
+
+    FILE* file = fopen(path.c_str(), "w");
+    if(!file) {
+        std::cout << "Failed to write frame time log: " << path << std::endl;
+        return false;
+    }
+    fprintf(file, "kind,index,ms,interval_ms\n");
+    for(size_t i = 0; i < ticks.size(); i++) {
+        fprintf(file, "tick,%zu,%.4f,\n", i + 1, ticks[i]);
+    }
+    for(size_t i = 0; i < frames.size(); i++) {
+        fprintf(file, "frame,%zu,%.4f,%.4f\n", i + 1, frames[i], intervals[i]);
+    }
+    fclose(file);
+
+    std::cout << "\n=== Frame Times (ms) ===\n";
+    printSummary("tick", ticks);
+    printSummary("render", frames);
+    // Первый кадр интервала не имеет
+    printSummary("interval", intervals.empty() ? intervals : std::vector<float>(intervals.begin() + 1, intervals.end()));
+    std::cout << "========================\n";
+    std::cout << "Frame time log written to " << path << std::endl;
+    return true;
+}
+
+void FrameTimeLog::printSummary(const char* name, std::vector<float> values) {
+    if(values.empty()) return;
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](double p) {
+        return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+    };
+    const double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    char line[160];
+    snprintf(line, sizeof(line), "%-8s n=%-8zu mean=%.3f p50=%.3f p95=%.3f p99=%.3f max=%.3f\n",
+             name, values.size(), mean, percentile(0.5), percentile(0.95), percentile(0.99), values.back());
+    std::cout << line;
+}
@@ -0,0 +1,32 @@
+#ifndef FrameTimeLog_hpp
+#define FrameTimeLog_hpp
+
+#include <string>
+#include <vector>
+
+// Журнал длительностей тиков симуляции и кадров рендера для сравнения сборок.
+// Тики пишет поток симуляции, кадры - главный поток, каждый в свой массив.
+// На диск попадает один раз в конце: CSV со строками "tick,N,update_ms," и
+// "frame,N,render_ms,interval_ms", в консоль - перцентили.
+class FrameTimeLog {
+public:
+    void enable(const std::string& path);
+    bool isEnabled() const { return !path.empty(); }
+
+    void addTick(double seconds);
+    // frameStart - время начала кадра, интервал считается от начала прошлого кадра
+    void addFrame(double frameStart, double renderSeconds);
+
+    bool write() const;
+
+private:
+    std::string path;
+    std::vector<float> ticks;
+    std::vector<float> frames;
+    std::vector<float> intervals;
+    double lastFrameStart = 0.0;
+
+    static void printSummary(const char* name, std::vector<float> values);
+};
+
+#endif
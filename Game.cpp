@@ -1,8 +1,27 @@
 #include "Game.hpp"
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 
-Game::Game(){
-    sceneManager = nullptr;
+Game::Game()
+    : isRunning(false),
+      window(nullptr),
+      renderer(nullptr),
+      sceneManager(nullptr),
+      simulationSequence(0),
+      threadedSimulation(false),
+      simulationStep(1.0 / 40.0),
+      accumulator(0.0),
+      previousTime(0.0),
+      vsync(false),
+      simulationRunning(false),
+      simulationFinished(false),
+      moveX(0.0f),
+      moveY(0.0f),
+      rewindMilliseconds(5000),
+      headlessTarget(nullptr),
+      headlessStartTime(0.0)
+{
 }
 
 Game::~Game(){
@@ -10,13 +29,54 @@ Game::~Game(){
 }
 
 void Game::init(const char *title, int xpos, int ypos, int width, int height, bool fullscreen, const std::string& gamePath) {
-    int flags = SDL_WINDOW_SHOWN;  // Base flags
+    // Читаем settings.json: начальная сцена и параметры игрового цикла
+    json settings = json::object();
+    std::string settingsPath = gamePath + "/settings.json";
+    std::ifstream settingsFile(settingsPath);
+    bool hasSettings = settingsFile.is_open();
+    if (hasSettings) {
+        settingsFile >> settings;
+    }
+
+    threadedSimulation = settings.value("threadedSimulation", true);
+    simulationStep = 1.0 / std::max(settings.value("simulationRate", 40.0), 1.0);
+    double maxFps = 60.0;
+    if (settings.contains("window")) {
+        vsync = settings["window"].value("vsync", true);
+        maxFps = settings["window"].value("maxFps", 60.0);
+    }
+
+    // Повтор идет с тем шагом симуляции, с которым его записали
+    if (!recording.replayPath.empty() && inputReplay.load(recording.replayPath)) {
+        if (inputReplay.getSimulationStep() > 0.0 && inputReplay.getSimulationStep() != simulationStep) {
+            std::cout << "Replay: using recorded simulation step " << inputReplay.getSimulationStep() << std::endl;
+            simulationStep = inputReplay.getSimulationStep();
+        }
+        if (headless.enabled) {
+            headless.ticks = inputReplay.length();
+        }
+    }
+    rewindMilliseconds = static_cast<int>(settings.value("rewindSeconds", 5.0) * 1000.0);
+    if (!recording.frameLogPath.empty()) {
+        frameTimeLog.enable(recording.frameLogPath);
+    }
+
+    // Без окна: никакого vsync и ожидания, симуляция в главном потоке для детерминизма
+    if (headless.enabled) {
+        threadedSimulation = false;
+        vsync = false;
+        maxFps = 0.0;
+    }
+
+    int flags = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE;  // Base flags
     if (fullscreen) {
         flags |= SDL_WINDOW_FULLSCREEN;
     }
-    // Note: We're not adding SDL_WINDOW_RESIZABLE flag, making window fixed size
+
+    // Headless не требует дисплея: видеоподсистема не нужна
+    Uint32 subsystems = headless.enabled ? (SDL_INIT_TIMER | SDL_INIT_EVENTS) : SDL_INIT_EVERYTHING;
     
-    if(SDL_Init(SDL_INIT_EVERYTHING) == 0) {
+    if(SDL_Init(subsystems) == 0) {
         std::cout << "Subsystems Initialized!..." << std::endl;
         
         // Initialize SDL_Image for PNG support
@@ -26,36 +86,83 @@ void Game::init(const char *title, int xpos, int ypos, int width, int height, bo
             return;
         }
 
-        // Get desktop display mode
-        SDL_DisplayMode displayMode;
-        if (SDL_GetDesktopDisplayMode(0, &displayMode) == 0) {
-            xpos = (displayMode.w - width) / 2;
-            ypos = (displayMode.h - height) / 2;
-        }
+        if(headless.enabled) {
+            if(!createHeadlessRenderer(width, height)) {
+                isRunning = false;
+                return;
+            }
+        } else {
+            // Get desktop display mode
+            SDL_DisplayMode displayMode;
+            if (SDL_GetDesktopDisplayMode(0, &displayMode) == 0) {
+                xpos = (displayMode.w - width) / 2;
+                ypos = (displayMode.h - height) / 2;
+            }
 
-        window = SDL_CreateWindow(title, xpos, ypos, width, height, flags);
-        if(window){
-            std::cout << "Window created!" << std::endl;
+            window = SDL_CreateWindow(title, xpos, ypos, width, height, flags);
+            if(window){
+                std::cout << "Window created!" << std::endl;
+            }
+
+            renderer = SDL_CreateRenderer(window, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
         }
 
-        renderer = SDL_CreateRenderer(window, -1, 0);
         if(renderer){
             SDL_SetRenderDrawColor(renderer, 255,255,255,255);
             std::cout << "renderer created!" << std::endl;
+
+            // Если драйвер не дал vsync, темп кадров держим сами
+            SDL_RendererInfo info;
+            if(vsync && SDL_GetRendererInfo(renderer, &info) == 0 && !(info.flags & SDL_RENDERER_PRESENTVSYNC)) {
+                vsync = false;
+            }
+            framePacer.setRate(maxFps);
             
-            sceneManager = new SceneManager(renderer);
+            renderQueue.bindRenderThread();
+            sceneManager = new SceneManager(renderer, &renderQueue);
             sceneManager->setGamePath(gamePath);
+            // Журнал отката: история изменений сцены в кольцевом буфере
+            sceneManager->setJournalBudget(static_cast<size_t>(std::max(settings.value("rewindJournalKB", 1024), 0)) * 1024);
 
-            // Читаем начальную сцену из settings.json
-            std::string settingsPath = gamePath + "/settings.json";
-            std::ifstream settingsFile(settingsPath);
-            if (settingsFile.is_open()) {
-                json settings;
-                settingsFile >> settings;
+            if(headless.enabled) {
+                sceneManager->setRandomSeed(headless.seed);
+                scriptedInput.setSeed(headless.seed);
+                if(!headless.inputScript.empty()) {
+                    scriptedInput.load(headless.inputScript);
+                }
+            }
+            if(inputReplay.isActive()) {
+                sceneManager->setRandomSeed(inputReplay.getSeed());
+            }
+            if(!recording.recordPath.empty()) {
+                Uint32 seed = inputReplay.isActive() ? inputReplay.getSeed() : (headless.enabled ? headless.seed : 0);
+                inputRecorder.open(recording.recordPath, simulationStep, seed);
+            }
+
+            // Начальная сцена из settings.json
+            if (hasSettings) {
                 sceneManager->loadScene(settings["initialScene"]);
             } else {
                 sceneManager->loadScene("error"); // Fallback если файл не найден
             }
+
+            // Правки сцен, картинок и шрифтов подхватываются без перезапуска. В headless - никогда,
+            // прогон должен зависеть только от входных данных
+            // Запись и повтор тоже: правка сцены посреди сессии не воспроизведется
+            if(settings.value("hotReload", true) && !headless.enabled &&
+               !inputReplay.isActive() && !inputRecorder.isActive()) {
+                sceneManager->enableHotReload();
+            }
+
+            previousTime = FramePacer::now();
+            headlessStartTime = previousTime;
+
+            // Симуляция уходит в свой поток, главный поток только обрабатывает события и рисует
+            if(threadedSimulation) {
+                renderQueue.setThreaded(true);
+                simulationRunning = true;
+                simulationThread = std::thread(&Game::simulationLoop, this);
+            }
         }
 
         isRunning = true;
@@ -64,6 +171,36 @@ void Game::init(const char *title, int xpos, int ypos, int width, int height, bo
     }
 }
 
+bool Game::createHeadlessRenderer(int width, int height) {
+    // Программный рендер прямо в поверхность в памяти
+    headlessTarget = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if(!headlessTarget) {
+        std::cout << "Failed to create headless target: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    renderer = SDL_CreateSoftwareRenderer(headlessTarget);
+    if(!renderer) {
+        std::cout << "Failed to create software renderer: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    std::cout << "Headless target created: " << width << "x" << height << std::endl;
+    return true;
+}
+
+void Game::dumpFrame(Uint64 tick) {
+    bool selected = headless.dumpFrames.count(tick) != 0 ||
+                    (headless.dumpEvery > 0 && tick % headless.dumpEvery == 0);
+    if(!selected) return;
+
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "/frame_%06llu.png", static_cast<unsigned long long>(tick));
+    std::string path = headless.dumpDir + fileName;
+    if(IMG_SavePNG(headlessTarget, path.c_str()) != 0) {
+        std::cout << "Failed to save frame " << path << ": " << IMG_GetError() << std::endl;
+    }
+}
+
 void Game::handleEvents() {
     SDL_Event event;
     while(SDL_PollEvent(&event)) {
@@ -71,46 +208,189 @@ void Game::handleEvents() {
             case SDL_QUIT:
                 isRunning = false;
                 break;
+
+            case SDL_WINDOWEVENT:
+                // Размер вывода отслеживаем только здесь, рендер его больше не запрашивает
+                if(event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                    queueInput(InputAction::Resize, event.window.data1, event.window.data2);
+                }
+                break;
             
             case SDL_KEYDOWN:
                 if(event.key.keysym.sym == SDLK_p) {
-                    if(sceneManager) {
-                        auto [row, col] = sceneManager->getCurrentPlayerCell();
-                        std::cout << "Player is at: row=" << row << ", col=" << col << std::endl;
-                    }
+                    queueInput(InputAction::PrintPlayerCell);
                 }
                 else if(event.key.keysym.sym == SDLK_z) {
-                    if(sceneManager) {
-                        sceneManager->handleUseKey();
-                    }
+                    queueInput(InputAction::Use);
                 }
                 else if(event.key.keysym.sym == SDLK_d) {
-                    if(sceneManager) {
-                        sceneManager->toggleDialog("testDialog");
-                    }
+                    queueInput(InputAction::ToggleTestDialog);
                 }
                 else if(event.key.keysym.sym == SDLK_v) {
-                    if(sceneManager) {
-                        sceneManager->debugPrintVariables();
-                    }
+                    queueInput(InputAction::PrintVariables);
+                }
+                else if(event.key.keysym.sym == SDLK_o) {
+                    queueInput(InputAction::PrintScriptProfile);
+                }
+                else if(event.key.keysym.sym == SDLK_r) {
+                    queueInput(InputAction::Rewind, rewindMilliseconds);
+                }
+                else if(event.key.keysym.sym == SDLK_a) {
+                    queueInput(InputAction::PrintAssetStats);
                 }
                 break;
         }
     }
+
+    // В headless движение приходит из сценария
+    if(!headless.enabled) {
+        handleMovementKeys();
+    }
+}
+
+void Game::queueInput(InputAction action, int data1, int data2) {
+    std::lock_guard<std::mutex> lock(inputMutex);
+    pendingInput.push_back({action, data1, data2});
+}
+
+void Game::applyInput(const InputEvent& input) {
+    switch(input.action) {
+        case InputAction::PrintPlayerCell: {
+            auto [row, col] = sceneManager->getCurrentPlayerCell();
+            std::cout << "Player is at: row=" << row << ", col=" << col << std::endl;
+            break;
+        }
+        case InputAction::Use:
+            sceneManager->handleUseKey();
+            break;
+        case InputAction::ToggleTestDialog:
+            sceneManager->toggleDialog("testDialog");
+            break;
+        case InputAction::PrintVariables:
+            sceneManager->debugPrintVariables();
+            break;
+        case InputAction::PrintScriptProfile:
+            sceneManager->debugPrintScriptProfile();
+            break;
+        case InputAction::Rewind:
+            sceneManager->rewind(input.data1 / 1000.0f);
+            break;
+        case InputAction::Resize:
+            sceneManager->setOutputSize(input.data1, input.data2);
+            break;
+        case InputAction::PrintAssetStats:
+            sceneManager->debugPrintAssetStats();
+            break;
+    }
 }
 
 void Game::update() {
-    if(sceneManager) {
-        handleMovementKeys();
-        sceneManager->update(1.0f / 40.0f); // Changed from 30 to 40 FPS
+    // В многопоточном режиме симуляция идет в своем потоке
+    if(!sceneManager || threadedSimulation) return;
+
+    if(headless.enabled) {
+        // Ровно один тик на итерацию, без привязки к реальному времени
+        if(simulationSequence >= headless.ticks) {
+            isRunning = false;
+            return;
+        }
+        if(!inputReplay.isActive()) {
+            float dx, dy;
+            std::vector<InputEvent> events;
+            scriptedInput.poll(simulationSequence + 1, dx, dy, events);
+            std::lock_guard<std::mutex> lock(inputMutex);
+            pendingInput.insert(pendingInput.end(), events.begin(), events.end());
+            moveX = dx;
+            moveY = dy;
+        }
+        simulationTick(static_cast<float>(simulationStep));
+        return;
+    }
+
+    // Симуляция идет фиксированными шагами, сколько бы времени ни занял кадр
+    double currentTime = FramePacer::now();
+    accumulator += std::min(currentTime - previousTime, MAX_FRAME_TIME);
+    previousTime = currentTime;
+
+    while(accumulator >= simulationStep) {
+        simulationTick(static_cast<float>(simulationStep));
+        accumulator -= simulationStep;
     }
 }
 
+void Game::waitForNextFrame() {
+    // С vsync кадр выравнивает SDL_RenderPresent
+    if(!vsync) {
+        framePacer.wait();
+    }
+}
+
+void Game::simulationTick(float deltaTime) {
+    const double tickStart = FramePacer::now();
+    float dx, dy;
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        tickInput.swap(pendingInput);
+        dx = moveX;
+        dy = moveY;
+    }
+
+    // Текстуры, отпущенные в этом тике, не попадут в снимок с этим номером
+    Uint64 sequence = ++simulationSequence;
+    renderQueue.setSimulationSequence(sequence);
+
+    if(inputReplay.isActive()) {
+        // Живой ввод при повторе отбрасывается, тик получает записанный
+        tickInput.clear();
+        inputReplay.poll(sequence, dx, dy, tickInput);
+        if(inputReplay.finished(sequence)) {
+            std::cout << "Replay finished at tick " << sequence << std::endl;
+            inputReplay.stop();
+        }
+    }
+    inputRecorder.record(sequence, dx, dy, tickInput);
+
+    for(const auto& input : tickInput) {
+        applyInput(input);
+    }
+    tickInput.clear();
+
+    sceneManager->updatePlayerVelocity(dx, dy);
+    sceneManager->update(deltaTime);
+
+    RenderState& state = renderStates.writeBuffer();
+    sceneManager->captureRenderState(state);
+    state.sequence = sequence;
+    state.timestamp = FramePacer::now();
+    renderStates.publish();
+
+    if(frameTimeLog.isEnabled()) {
+        frameTimeLog.addTick(FramePacer::now() - tickStart);
+    }
+}
+
+void Game::simulationLoop() {
+    double lag = 0.0;
+    double lastTime = FramePacer::now();
+
+    while(simulationRunning) {
+        double currentTime = FramePacer::now();
+        lag += std::min(currentTime - lastTime, MAX_FRAME_TIME);
+        lastTime = currentTime;
+
+        while(lag >= simulationStep) {
+            simulationTick(static_cast<float>(simulationStep));
+            lag -= simulationStep;
+        }
+
+        FramePacer::sleepUntil(currentTime + simulationStep - lag);
+    }
+    simulationFinished = true;
+}
+
 void Game::handleMovementKeys() {
     const Uint8* keyState = SDL_GetKeyboardState(NULL);
     
-    if(!sceneManager) return;
-    
     float dx = 0.0f, dy = 0.0f;
     
     if(keyState[SDL_SCANCODE_UP]) {
@@ -133,25 +413,78 @@ void Game::handleMovementKeys() {
         dy *= normalize;
     }
     
-    sceneManager->updatePlayerVelocity(dx, dy);
+    std::lock_guard<std::mutex> lock(inputMutex);
+    moveX = dx;
+    moveY = dy;
 }
 
 void Game::render(){
+    const double frameStart = FramePacer::now();
+    // Берем самый свежий снимок, затем обслуживаем запросы потока симуляции
+    renderStates.acquire();
+    const RenderState& state = renderStates.readBuffer();
+    renderQueue.process(state.sequence);
+
+    if(!state.valid) return;
+
+    // Доля шага симуляции, прошедшая после последнего тика
+    double alpha;
+    if(headless.enabled) {
+        alpha = 1.0;
+    } else if(threadedSimulation) {
+        alpha = (FramePacer::now() - state.timestamp) / simulationStep;
+    } else {
+        alpha = accumulator / simulationStep;
+    }
+    alpha = std::clamp(alpha, 0.0, 1.0);
+
     SDL_RenderClear(renderer);
     
     // Рендерим текущую сцену
     if(sceneManager) {
-        sceneManager->render();
+        sceneManager->render(state, static_cast<float>(alpha));
     }
     
     SDL_RenderPresent(renderer);
 
+    if(frameTimeLog.isEnabled()) {
+        frameTimeLog.addFrame(frameStart, FramePacer::now() - frameStart);
+    }
+    if(headless.enabled) {
+        dumpFrame(state.sequence);
+    }
 }
 void Game::clean(){
-    SDL_DestroyWindow(window);
-    SDL_DestroyRenderer(renderer);
+    if(simulationThread.joinable()) {
+        simulationRunning = false;
+        // Поток симуляции может ждать задачу рендера - обслуживаем очередь до его завершения
+        while(!simulationFinished) {
+            renderQueue.process(renderStates.readBuffer().sequence);
+            SDL_Delay(1);
+        }
+        simulationThread.join();
+    }
+    renderQueue.setThreaded(false);
+    renderQueue.flush();
+
+    if(sceneManager && !recording.scriptProfilePath.empty()) {
+        sceneManager->writeScriptProfile(recording.scriptProfilePath);
+    }
+    inputRecorder.close();
+    frameTimeLog.write();
+    delete sceneManager;
+    sceneManager = nullptr;
+
+    if(headless.enabled) {
+        double elapsed = FramePacer::now() - headlessStartTime;
+        std::cout << "Headless run: " << simulationSequence << " ticks in " << elapsed << " s ("
+                  << (elapsed > 0.0 ? simulationSequence / elapsed : 0.0) << " ticks/s)" << std::endl;
+    }
+
+    if(renderer) SDL_DestroyRenderer(renderer);
+    if(window) SDL_DestroyWindow(window);
+    if(headlessTarget) SDL_FreeSurface(headlessTarget);
     IMG_Quit();
     SDL_Quit();
     std::cout << "Game Cleaned!" << std::endl;
 }
-
@@ -3,18 +3,56 @@
 
 #include "SDL2/SDL.h"
 #include "SceneManager.hpp"
+#include "FramePacer.hpp"
+#include "FrameTimeLog.hpp"
+#include "InputRecording.hpp"
+#include "InputEvent.hpp"
+#include "RenderQueue.hpp"
+#include "RenderState.hpp"
+#include "ScriptedInput.hpp"
+#include "TripleBuffer.hpp"
+#include <atomic>
 #include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Параметры прогона без окна (--headless): рендер в программную поверхность,
+// один тик симуляции на итерацию цикла без ожидания, ввод из сценария или по seed
+struct HeadlessOptions {
+    bool enabled = false;
+    Uint64 ticks = 600;            // Сколько тиков прогнать перед выходом
+    Uint32 seed = 1;
+    std::string inputScript;       // Пусто - случайный ввод по seed
+    std::set<Uint64> dumpFrames;   // Номера тиков, кадры которых сохраняются в PNG
+    Uint64 dumpEvery = 0;          // Дополнительно каждый N-й кадр, 0 - выключено
+    std::string dumpDir = ".";
+};
+
+// Запись и повтор ввода (--record / --replay), журнал времени кадров (--frame-log)
+// и профиль скриптов при выходе (--script-profile).
+// Повтор работает и с окном, и в headless; в headless прогон идет до конца записи
+struct RecordingOptions {
+    std::string recordPath;
+    std::string replayPath;
+    std::string frameLogPath;
+    std::string scriptProfilePath;  // Пусто - профиль не пишется, клавиша O печатает его по запросу
+};
 
 class Game {
 public:
     Game();
     ~Game();
 
+    void setHeadless(const HeadlessOptions& options) { headless = options; }
+    void setRecording(const RecordingOptions& options) { recording = options; }
     void init(const char* title, int xpos, int ypos, int width, int height, bool fullscreen, const std::string& gamePath);
     
     void handleEvents();
     void update();
     void render();
+    void waitForNextFrame();
     void clean();
 
     bool running(){ return isRunning; }
@@ -24,7 +62,46 @@ private:
     SDL_Renderer *renderer;
     SceneManager* sceneManager;
 
+    RenderQueue renderQueue;
+    TripleBuffer<RenderState> renderStates;
+    // Самый длинный кадр, который учитывается симуляцией - иначе после паузы она не догонит
+    static constexpr double MAX_FRAME_TIME = 0.25;
+
+    Uint64 simulationSequence;
+    bool threadedSimulation;
+    double simulationStep;   // Фиксированный шаг симуляции в секундах
+    double accumulator;      // Несимулированное время (однопоточный режим)
+    double previousTime;
+    bool vsync;
+    FramePacer framePacer;
+    std::thread simulationThread;
+    std::atomic<bool> simulationRunning;
+    std::atomic<bool> simulationFinished;
+
+    std::mutex inputMutex;
+    std::vector<InputEvent> pendingInput;
+    std::vector<InputEvent> tickInput;
+    float moveX;
+    float moveY;
+    int rewindMilliseconds;  // Откат по клавише R
+
+    HeadlessOptions headless;
+    SDL_Surface* headlessTarget;
+    ScriptedInput scriptedInput;
+    double headlessStartTime;
+
+    RecordingOptions recording;
+    InputRecorder inputRecorder;
+    InputReplay inputReplay;
+    FrameTimeLog frameTimeLog;
+
     void handleMovementKeys(); // Новый метод для обработки клавиш движения
+    void queueInput(InputAction action, int data1 = 0, int data2 = 0);
+    void applyInput(const InputEvent& input);
+    void simulationTick(float deltaTime);
+    void simulationLoop();
+    bool createHeadlessRenderer(int width, int height);
+    void dumpFrame(Uint64 tick);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,233 @@
+#include "GlyphAtlas.hpp"
+#include <algorithm>
+#include <iostream>
+
+bool nextCodepoint(const std::string& text, size_t& pos, Uint32& codepoint) {
+    if(pos >= text.size()) return false;
+    const unsigned char lead = static_cast<unsigned char>(text[pos]);
+    int length;
+    if(lead < 0x80) {
+        codepoint = lead;
+        pos++;
+        return true;
+    } else if((lead & 0xE0) == 0xC0) {
+        codepoint = lead & 0x1F;
+        length = 2;
+    } else if((lead & 0xF0) == 0xE0) {
+        codepoint = lead & 0x0F;
+        length = 3;
+    } else if((lead & 0xF8) == 0xF0) {
+        codepoint = lead & 0x07;
+        length = 4;
+    } else {
+        codepoint = 0xFFFD;
+        pos++;
+        return true;
+    }
+
+    if(pos + length > text.size()) return false;
+    for(int i = 1; i < length; i++) {
+        const unsigned char next = static_cast<unsigned char>(text[pos + i]);
+        if((next & 0xC0) != 0x80) {
+            codepoint = 0xFFFD;
+            pos++;
+            return true;
+        }
+        codepoint = (codepoint << 6) | (next & 0x3F);
+    }
+    pos += length;
+    return true;
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    close();
+}
+
+bool GlyphAtlas::open(SDL_Renderer* newRenderer, const std::string& fontPath, int size) {
+    TTF_Font* newFont = TTF_OpenFont(fontPath.c_str(), size);
+    if(!newFont) {
+        std::cout << "Failed to load font! SDL_ttf Error: " << TTF_GetError() << std::endl;
+        return false;
+    }
+    close();
+    renderer = newRenderer;
+    font = newFont;
+    lineHeight = TTF_FontLineSkip(font);
+    return true;
+}
+
+void GlyphAtlas::close() {
+    for(auto& page : pages) {
+        if(page.texture) SDL_DestroyTexture(page.texture);
+    }
+    pages.clear();
+    asciiGlyphs.fill(Glyph());
+    otherGlyphs.clear();
+    if(font) {
+        TTF_CloseFont(font);
+        font = nullptr;
+    }
+}
+
+const GlyphAtlas::Glyph& GlyphAtlas::getGlyph(Uint32 codepoint) {
+    Glyph& glyph = codepoint < asciiGlyphs.size() ? asciiGlyphs[codepoint] : otherGlyphs[codepoint];
+    if(!glyph.loaded) loadGlyph(codepoint, glyph);
+    return glyph;
+}
+
+void GlyphAtlas::loadGlyph(Uint32 codepoint, Glyph& glyph) {
+    glyph.loaded = true;
+    if(!TTF_GlyphIsProvided32(font, codepoint)) {
+        // Символа нет в шрифте - рисуем '?', как и TTF_RenderText
+        if(codepoint != '?') glyph = getGlyph('?');
+        return;
+    }
+
+    int minX, maxX, minY, maxY;
+    TTF_GlyphMetrics32(font, codepoint, &minX, &maxX, &minY, &maxY, &glyph.advance);
+    glyph.offsetX = std::min(0, minX);
+    if(maxX <= minX) return;  // Пробелы: только сдвиг пера
+
+    const SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface* rendered = TTF_RenderGlyph32_Blended(font, codepoint, white);
+    if(!rendered) return;
+    SDL_Surface* surface = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(rendered);
+    if(!surface) return;
+
+    if(allocate(surface->w, surface->h, glyph.page, glyph.source)) {
+        SDL_UpdateTexture(pages[glyph.page].texture, &glyph.source, surface->pixels, surface->pitch);
+    } else {
+        std::cout << "Glyph does not fit into atlas page: U+" << std::hex << codepoint << std::dec << std::endl;
+    }
+    SDL_FreeSurface(surface);
+}
+
+bool GlyphAtlas::allocate(int width, int height, int& page, SDL_Rect& rect) {
+    const int paddedWidth = width + GLYPH_PADDING;
+    const int paddedHeight = height + GLYPH_PADDING;
+    if(paddedWidth > PAGE_SIZE || paddedHeight > PAGE_SIZE) return false;
+
+    if(pages.empty()) addPage();
+    Page* current = &pages.back();
+    if(current->shelfX + paddedWidth > PAGE_SIZE) {
+        // Новая полка под текущей
+        current->shelfY += current->shelfHeight;
+        current->shelfX = 0;
+        current->shelfHeight = 0;
+    }
+    if(current->shelfY + paddedHeight > PAGE_SIZE) {
+        addPage();
+        current = &pages.back();
+    }
+
+    page = static_cast<int>(pages.size()) - 1;
+    rect = {current->shelfX, current->shelfY, width, height};
+    current->shelfX += paddedWidth;
+    current->shelfHeight = std::max(current->shelfHeight, paddedHeight);
+    return true;
+}
+
+void GlyphAtlas::addPage() {
+    Page page;
+    page.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, PAGE_SIZE, PAGE_SIZE);
+    if(page.texture) {
+        // Промежутки между глифами должны быть прозрачными
+        std::vector<Uint32> clear(PAGE_SIZE * PAGE_SIZE, 0);
+        SDL_UpdateTexture(page.texture, nullptr, clear.data(), PAGE_SIZE * sizeof(Uint32));
+        SDL_SetTextureBlendMode(page.texture, SDL_BLENDMODE_BLEND);
+    } else {
+        std::cout << "Failed to create glyph atlas page: " << SDL_GetError() << std::endl;
+    }
+    pages.push_back(std::move(page));
+}
+
+void GlyphAtlas::layout(const std::string& text, TextLayout& out, int maxWidth) {
+    out.clear();
+    if(!font) return;
+
+    int penX = 0;
+    int penY = 0;
+    Uint32 previous = 0;
+    // Последний пробел текущей строки: после него можно перенести
+    size_t breakAfter = 0;
+    int breakPen = 0;
+    bool canBreak = false;
+    size_t pos = 0;
+    Uint32 codepoint;
+    while(nextCodepoint(text, pos, codepoint)) {
+        if(codepoint == '\n') {
+            out.glyphs.push_back({0.0f, 0.0f, -1, {0, 0, 0, 0}});
+            penX = 0;
+            penY += lineHeight;
+            previous = 0;
+            canBreak = false;
+            continue;
+        }
+        if(previous) penX += TTF_GetFontKerningSizeGlyphs32(font, previous, codepoint);
+        previous = codepoint;
+
+        const Glyph& glyph = getGlyph(codepoint);
+        const bool space = codepoint == ' ' || codepoint == '\t';
+        // Пробелы могут свисать за край, переносится только видимый символ
+        if(maxWidth > 0 && !space && penX > 0 && penX + glyph.advance > maxWidth) {
+            if(canBreak) {
+                // Хвост строки после пробела уходит на следующую строку
+                for(size_t i = breakAfter; i < out.glyphs.size(); i++) {
+                    out.glyphs[i].x -= breakPen;
+                    out.glyphs[i].y += lineHeight;
+                }
+                penX -= breakPen;
+            } else {
+                penX = 0;
+            }
+            penY += lineHeight;
+            canBreak = false;
+        }
+
+        out.glyphs.push_back({static_cast<float>(penX + glyph.offsetX), static_cast<float>(penY), glyph.page, glyph.source});
+        penX += glyph.advance;
+        if(space) {
+            breakAfter = out.glyphs.size();
+            breakPen = penX;
+            canBreak = true;
+        }
+    }
+}
+
+void GlyphAtlas::draw(const TextLayout& text, float x, float y, size_t count, SDL_Color color) {
+    count = std::min(count, text.glyphs.size());
+    for(size_t i = 0; i < count; i++) {
+        const TextLayout::Glyph& glyph = text.glyphs[i];
+        if(glyph.page < 0 || static_cast<size_t>(glyph.page) >= pages.size()) continue;
+
+        Page& page = pages[glyph.page];
+        const float left = x + glyph.x;
+        const float top = y + glyph.y;
+        const float right = left + glyph.source.w;
+        const float bottom = top + glyph.source.h;
+        const float u0 = static_cast<float>(glyph.source.x) / PAGE_SIZE;
+        const float v0 = static_cast<float>(glyph.source.y) / PAGE_SIZE;
+        const float u1 = static_cast<float>(glyph.source.x + glyph.source.w) / PAGE_SIZE;
+        const float v1 = static_cast<float>(glyph.source.y + glyph.source.h) / PAGE_SIZE;
+
+        const int base = static_cast<int>(page.vertices.size());
+        page.vertices.push_back({{left, top}, color, {u0, v0}});
+        page.vertices.push_back({{right, top}, color, {u1, v0}});
+        page.vertices.push_back({{right, bottom}, color, {u1, v1}});
+        page.vertices.push_back({{left, bottom}, color, {u0, v1}});
+        const int quad[6] = {base, base + 1, base + 2, base, base + 2, base + 3};
+        page.indices.insert(page.indices.end(), quad, quad + 6);
+    }
+
+    // Один вызов на страницу; буферы сохраняют емкость до следующего кадра
+    for(auto& page : pages) {
+        if(page.indices.empty()) continue;
+        if(page.texture) {
+            SDL_RenderGeometry(renderer, page.texture, page.vertices.data(), static_cast<int>(page.vertices.size()),
+                               page.indices.data(), static_cast<int>(page.indices.size()));
+        }
+        page.vertices.clear();
+        page.indices.clear();
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef GlyphAtlas_hpp
+#define GlyphAtlas_hpp
+
+#include "SDL2/SDL.h"
+#include "SDL2/SDL_ttf.h"
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Следующий символ UTF-8 с позиции pos; false в конце строки или на оборванной последовательности.
+// Неверный байт читается как U+FFFD
+bool nextCodepoint(const std::string& text, size_t& pos, Uint32& codepoint);
+
+// Строка, разложенная атласом один раз: по записи на каждый символ (включая пробелы и переводы строк),
+// координаты от начала текста. Первые N записей - первые N символов, так печатная машинка рисует префикс
+struct TextLayout {
+    struct Glyph {
+        float x;
+        float y;
+        int page;  // -1 - ничего не рисуется
+        SDL_Rect source;
+    };
+    std::vector<Glyph> glyphs;
+
+    void clear() { glyphs.clear(); }
+};
+
+// Атлас глифов одного шрифта одного размера. Глифы растеризуются белыми при первой встрече
+// и кладутся полками в текстуры-страницы, которые живут до закрытия шрифта.
+// Текст раскладывается один раз, затем рисуется четырехугольниками из атласа
+// одним SDL_RenderGeometry на страницу, цвет задается вершинами. Все вызовы - только из потока рендера.
+// Раскладка ссылается на страницы атласа и устаревает при open/close.
+class GlyphAtlas {
+public:
+    GlyphAtlas() = default;
+    ~GlyphAtlas();
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+    // Открывает шрифт; при ошибке остается прежний шрифт и его атлас
+    bool open(SDL_Renderer* renderer, const std::string& fontPath, int size);
+    void close();
+    bool isOpen() const { return font != nullptr; }
+
+    int getLineHeight() const { return lineHeight; }
+    // Текст в UTF-8, '\n' - перевод строки; глифы попадают в атлас здесь.
+    // maxWidth > 0 - перенос по словам (слово длиннее строки режется по символам).
+    // Перенос только сдвигает записи, их число остается равным числу символов
+    void layout(const std::string& text, TextLayout& out, int maxWidth = 0);
+    // Первые count символов раскладки
+    void draw(const TextLayout& text, float x, float y, size_t count, SDL_Color color);
+
+private:
+    static constexpr int PAGE_SIZE = 512;
+    static constexpr int GLYPH_PADDING = 1;  // Чтобы фильтрация не захватывала соседей
+
+    struct Glyph {
+        bool loaded = false;
+        int page = -1;       // -1 - пустой глиф (пробел), только сдвиг
+        SDL_Rect source{0, 0, 0, 0};
+        int offsetX = 0;     // Глиф с отрицательным minx начинается левее пера
+        int advance = 0;
+    };
+
+    struct Page {
+        SDL_Texture* texture = nullptr;
+        int shelfX = 0;       // Свободное место на текущей полке
+        int shelfY = 0;
+        int shelfHeight = 0;
+        std::vector<SDL_Vertex> vertices;  // Буферы кадра, переиспользуются
+        std::vector<int> indices;
+    };
+
+    SDL_Renderer* renderer = nullptr;
+    TTF_Font* font = nullptr;
+    int lineHeight = 0;
+    std::vector<Page> pages;
+    std::array<Glyph, 128> asciiGlyphs;
+    std::unordered_map<Uint32, Glyph> otherGlyphs;
+
+    const Glyph& getGlyph(Uint32 codepoint);
+    void loadGlyph(Uint32 codepoint, Glyph& glyph);
+    bool allocate(int width, int height, int& page, SDL_Rect& rect);
+    void addPage();
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef InputEvent_hpp
+#define InputEvent_hpp
+
+#include <cstdint>
+
+// Действия игрока, собранные в главном потоке и применяемые в тике симуляции
+enum class InputAction : uint8_t {
+    Use,
+    PrintPlayerCell,
+    ToggleTestDialog,
+    PrintVariables,
+    PrintScriptProfile,
+    Rewind,   // data1 - на сколько миллисекунд откатить сцену
+    Resize,
+    PrintAssetStats
+};
+
+struct InputEvent {
+    InputAction action;
+    int data1;
+    int data2;
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "InputRecording.hpp"
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+using namespace InputRecordingFormat;
+
+namespace {
+
+void putBytes(std::vector<uint8_t>& out, uint64_t value, int count) {
+    for(int i = 0; i < count; i++) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while(value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void putFloat(std::vector<uint8_t>& out, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putBytes(out, bits, 4);
+}
+
+// Чтение из буфера целого файла; при выходе за конец ok сбрасывается
+struct Reader {
+    const std::vector<uint8_t>& data;
+    size_t pos = 0;
+    bool ok = true;
+
+    uint64_t bytes(int count) {
+        if(pos + count > data.size()) {
+            ok = false;
+            return 0;
+        }
+        uint64_t value = 0;
+        for(int i = 0; i < count; i++) {
+            value |= static_cast<uint64_t>(data[pos++]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for(int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(bytes(1));
+            if(!ok) return 0;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if(!(byte & 0x80)) return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    float f32() {
+        uint32_t bits = static_cast<uint32_t>(bytes(4));
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    double f64() {
+        uint64_t bits = bytes(8);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+uint64_t zigzag(int value) {
+    return (static_cast<uint64_t>(static_cast<int64_t>(value)) << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(value) >> 63);
+}
+
+int unzigzag(uint64_t value) {
+    return static_cast<int>(static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1));
+}
+
+}
+
+InputRecorder::~InputRecorder() {
+    close();
+}
+
+bool InputRecorder::open(const std::string& path, double simulationStep, Uint32 seed) {
+    close();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if(!file.is_open()) {
+        std::cout << "Failed to open input recording: " << path << std::endl;
+        return false;
+    }
+
+    buffer.clear();
+    buffer.insert(buffer.end(), std::begin(MAGIC), std::end(MAGIC));
+    putBytes(buffer, VERSION, 2);
+    putBytes(buffer, 0, 2);
+    uint64_t stepBits;
+    std::memcpy(&stepBits, &simulationStep, sizeof(stepBits));
+    putBytes(buffer, stepBits, 8);
+    putBytes(buffer, seed, 4);
+
+    lastTick = 0;
+    currentTick = 0;
+    lastX = 0.0f;
+    lastY = 0.0f;
+    std::cout << "Recording input to " << path << std::endl;
+    return true;
+}
+
+void InputRecorder::record(Uint64 tick, float moveX, float moveY, const std::vector<InputEvent>& events) {
+    if(!file.is_open()) return;
+    currentTick = tick;
+
+    const bool moved = moveX != lastX || moveY != lastY;
+    if(!moved && events.empty()) return;
+
+    putVarint(buffer, tick - lastTick);
+    buffer.push_back(static_cast<uint8_t>((moved ? FLAG_MOVE : 0) | (events.empty() ? 0 : FLAG_EVENTS)));
+    if(moved) {
+        putFloat(buffer, moveX);
+        putFloat(buffer, moveY);
+        lastX = moveX;
+        lastY = moveY;
+    }
+    if(!events.empty()) {
+        putVarint(buffer, events.size());
+        for(const auto& event : events) {
+            buffer.push_back(static_cast<uint8_t>(event.action));
+            putVarint(buffer, zigzag(event.data1));
+            putVarint(buffer, zigzag(event.data2));
+        }
+    }
+    lastTick = tick;
+
+    if(buffer.size() >= FLUSH_SIZE) flush();
+}
+
+void InputRecorder::flush() {
+    file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+}
+
+void InputRecorder::close() {
+    if(!file.is_open()) return;
+    putVarint(buffer, currentTick - lastTick);
+    buffer.push_back(FLAG_END);
+    flush();
+    file.close();
+    std::cout << "Input recording stopped at tick " << currentTick << std::endl;
+}
+
+bool InputReplay::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+        std::cout << "Failed to open input replay: " << path << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    Reader reader{data};
+    if(data.size() < sizeof(MAGIC) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        std::cout << "Not an input recording: " << path << std::endl;
+        return false;
+    }
+    reader.pos = sizeof(MAGIC);
+    const uint16_t version = static_cast<uint16_t>(reader.bytes(2));
+    reader.bytes(2);
+    if(version != VERSION) {
+        std::cout << "Unsupported input recording version " << version << ": " << path << std::endl;
+        return false;
+    }
+    simulationStep = reader.f64();
+    seed = static_cast<Uint32>(reader.bytes(4));
+
+    entries.clear();
+    events.clear();
+    Uint64 tick = 0;
+    bool ended = false;
+    while(reader.ok && reader.pos < data.size()) {
+        tick += reader.varint();
+        const uint8_t flags = static_cast<uint8_t>(reader.bytes(1));
+        if(flags & FLAG_END) {
+            ended = true;
+            break;
+        }
+
+        Entry entry{tick, false, 0.0f, 0.0f, static_cast<uint32_t>(events.size()), 0};
+        if(flags & FLAG_MOVE) {
+            entry.hasMove = true;
+            entry.moveX = reader.f32();
+            entry.moveY = reader.f32();
+        }
+        if(flags & FLAG_EVENTS) {
+            entry.eventCount = static_cast<uint32_t>(reader.varint());
+            for(uint32_t i = 0; i < entry.eventCount && reader.ok; i++) {
+                InputEvent event;
+                event.action = static_cast<InputAction>(reader.bytes(1));
+                event.data1 = unzigzag(reader.varint());
+                event.data2 = unzigzag(reader.varint());
+                events.push_back(event);
+            }
+        }
+        if(reader.ok) entries.push_back(entry);
+    }
+    // Игра могла упасть во время записи - повторяем то, что успело попасть на диск
+    if(!ended) {
+        std::cout << "Input recording is truncated, replaying " << entries.size() << " entries: " << path << std::endl;
+        tick = entries.empty() ? 0 : entries.back().tick;
+    }
+    endTick = tick;
+
+    nextEntry = 0;
+    currentX = 0.0f;
+    currentY = 0.0f;
+    active = true;
+    std::cout << "Replaying input from " << path << ": " << endTick << " ticks" << std::endl;
+    return true;
+}
+
+void InputReplay::poll(Uint64 tick, float& moveX, float& moveY, std::vector<InputEvent>& tickEvents) {
+    while(nextEntry < entries.size() && entries[nextEntry].tick <= tick) {
+        const Entry& entry = entries[nextEntry++];
+        if(entry.hasMove) {
+            currentX = entry.moveX;
+            currentY = entry.moveY;
+        }
+        tickEvents.insert(tickEvents.end(), events.begin() + entry.firstEvent,
+                          events.begin() + entry.firstEvent + entry.eventCount);
+    }
+    moveX = currentX;
+    moveY = currentY;
+}
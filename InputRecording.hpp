@@ -0,0 +1,85 @@
+#ifndef InputRecording_hpp
+#define InputRecording_hpp
+
+#include "InputEvent.hpp"
+#include "SDL2/SDL.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Двоичная запись ввода по тикам симуляции (little-endian):
+//   заголовок: "INPR", u16 версия, u16 резерв, f64 шаг симуляции, u32 seed;
+//   записи только для тиков, где ввод изменился: varint разница тиков, u8 флаги,
+//   [f32 x, f32 y] если сменилось движение, [varint число, {u8 действие, zigzag data1, data2}...] если были действия;
+//   последняя запись с флагом END отмечает тик, на котором запись остановлена.
+// Пока игрок стоит или держит одно направление, файл не растет.
+namespace InputRecordingFormat {
+    constexpr char MAGIC[4] = {'I', 'N', 'P', 'R'};
+    constexpr uint16_t VERSION = 1;
+    constexpr uint8_t FLAG_MOVE = 1;
+    constexpr uint8_t FLAG_EVENTS = 2;
+    constexpr uint8_t FLAG_END = 4;
+}
+
+class InputRecorder {
+public:
+    ~InputRecorder();
+
+    bool open(const std::string& path, double simulationStep, Uint32 seed);
+    bool isActive() const { return file.is_open(); }
+    // Ввод, который получил тик tick; вызывается для каждого тика по порядку
+    void record(Uint64 tick, float moveX, float moveY, const std::vector<InputEvent>& events);
+    // Дописывает метку конца и закрывает файл
+    void close();
+
+private:
+    static constexpr size_t FLUSH_SIZE = 4096;
+
+    std::ofstream file;
+    std::vector<uint8_t> buffer;  // Пишется на диск порциями, а не на каждом тике
+    Uint64 lastTick = 0;          // Тик последней записи
+    Uint64 currentTick = 0;       // Последний записанный тик, для метки конца
+    float lastX = 0.0f;
+    float lastY = 0.0f;
+
+    void flush();
+};
+
+// Повтор записанного ввода: тик получает ровно то движение и те действия, что и при записи
+class InputReplay {
+public:
+    bool load(const std::string& path);
+    bool isActive() const { return active; }
+    void stop() { active = false; }
+
+    double getSimulationStep() const { return simulationStep; }
+    Uint32 getSeed() const { return seed; }
+    // Число тиков в записи
+    Uint64 length() const { return endTick; }
+    bool finished(Uint64 tick) const { return tick >= endTick; }
+
+    void poll(Uint64 tick, float& moveX, float& moveY, std::vector<InputEvent>& events);
+
+private:
+    struct Entry {
+        Uint64 tick;
+        bool hasMove;
+        float moveX;
+        float moveY;
+        uint32_t firstEvent;  // События записи - events[firstEvent .. firstEvent + eventCount)
+        uint32_t eventCount;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<InputEvent> events;
+    size_t nextEntry = 0;
+    bool active = false;
+    double simulationStep = 0.0;
+    Uint32 seed = 0;
+    Uint64 endTick = 0;
+    float currentX = 0.0f;
+    float currentY = 0.0f;
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "ParticleSystem.hpp"
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+ParticleEmitter::ParticleEmitter(const ParticleEmitterConfig& emitterConfig)
+    : config(emitterConfig),
+      alive(0),
+      spawnAccumulator(0.0f),
+      rngState(emitterConfig.seed ? emitterConfig.seed : 1)
+{
+    // Округляем емкость до кратной 4, чтобы SIMD-цикл не требовал отдельной проверки границ пула
+    capacity = (static_cast<size_t>(std::max(config.capacity, 4)) + 3) & ~static_cast<size_t>(3);
+
+    posX.resize(capacity);
+    posY.resize(capacity);
+    velX.resize(capacity);
+    velY.resize(capacity);
+    life.resize(capacity);
+    invMaxLife.resize(capacity);
+    alpha.resize(capacity);
+}
+
+float ParticleEmitter::randomRange(float min, float max) {
+    // xorshift32 - быстрый и детерминированный при одинаковом seed
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    float t = (rngState >> 8) * (1.0f / 16777216.0f);
+    return min + (max - min) * t;
+}
+
+void ParticleEmitter::setViewport(int width, int height) {
+    (void)height;
+    if(config.followViewport) {
+        config.area.x = 0;
+        config.area.w = static_cast<float>(width);
+    }
+}
+
+void ParticleEmitter::burst(int count) {
+    if(count > 0) {
+        spawn(static_cast<size_t>(count));
+    }
+}
+
+void ParticleEmitter::spawn(size_t count) {
+    count = std::min(count, capacity - alive);
+    for(size_t n = 0; n < count; n++) {
+        size_t i = alive++;
+        posX[i] = randomRange(config.area.x, config.area.x + config.area.w);
+        posY[i] = randomRange(config.area.y, config.area.y + config.area.h);
+        velX[i] = randomRange(config.minVelX, config.maxVelX);
+        velY[i] = randomRange(config.minVelY, config.maxVelY);
+        float maxLife = std::max(randomRange(config.minLife, config.maxLife), 0.001f);
+        life[i] = maxLife;
+        invMaxLife[i] = config.fade ? 1.0f / maxLife : 0.0f;
+        alpha[i] = 1.0f;
+    }
+}
+
+void ParticleEmitter::update(float deltaTime) {
+    if(config.active && config.rate > 0.0f) {
+        spawnAccumulator += config.rate * deltaTime;
+        size_t toSpawn = static_cast<size_t>(spawnAccumulator);
+        spawnAccumulator -= static_cast<float>(toSpawn);
+        spawn(toSpawn);
+    }
+
+    integrate(deltaTime);
+    removeDead();
+}
+
+void ParticleEmitter::integrate(float deltaTime) {
+    const float gx = config.gravityX * deltaTime;
+    const float gy = config.gravityY * deltaTime;
+    // Без fade invMaxLife = 0, поэтому alpha = 1 без лишнего ветвления
+    const float baseAlpha = config.fade ? 0.0f : 1.0f;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128 vdt = _mm_set1_ps(deltaTime);
+    const __m128 vgx = _mm_set1_ps(gx);
+    const __m128 vgy = _mm_set1_ps(gy);
+    const __m128 vbase = _mm_set1_ps(baseAlpha);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for(; i + 4 <= alive; i += 4) {
+        __m128 vx = _mm_add_ps(_mm_loadu_ps(&velX[i]), vgx);
+        __m128 vy = _mm_add_ps(_mm_loadu_ps(&velY[i]), vgy);
+        _mm_storeu_ps(&velX[i], vx);
+        _mm_storeu_ps(&velY[i], vy);
+        _mm_storeu_ps(&posX[i], _mm_add_ps(_mm_loadu_ps(&posX[i]), _mm_mul_ps(vx, vdt)));
+        _mm_storeu_ps(&posY[i], _mm_add_ps(_mm_loadu_ps(&posY[i]), _mm_mul_ps(vy, vdt)));
+
+        __m128 l = _mm_sub_ps(_mm_loadu_ps(&life[i]), vdt);
+        _mm_storeu_ps(&life[i], l);
+        __m128 a = _mm_add_ps(_mm_mul_ps(l, _mm_loadu_ps(&invMaxLife[i])), vbase);
+        _mm_storeu_ps(&alpha[i], _mm_min_ps(_mm_max_ps(a, zero), one));
+    }
+#endif
+
+    for(; i < alive; i++) {
+        velX[i] += gx;
+        velY[i] += gy;
+        posX[i] += velX[i] * deltaTime;
+        posY[i] += velY[i] * deltaTime;
+        life[i] -= deltaTime;
+        alpha[i] = std::clamp(life[i] * invMaxLife[i] + baseAlpha, 0.0f, 1.0f);
+    }
+}
+
+void ParticleEmitter::removeDead() {
+    // Мертвые частицы заменяем последней живой, порядок в пуле не важен
+    size_t i = 0;
+    while(i < alive) {
+        if(life[i] <= 0.0f) {
+            size_t last = --alive;
+            posX[i] = posX[last];
+            posY[i] = posY[last];
+            velX[i] = velX[last];
+            velY[i] = velY[last];
+            life[i] = life[last];
+            invMaxLife[i] = invMaxLife[last];
+            alpha[i] = alpha[last];
+        } else {
+            i++;
+        }
+    }
+}
+
+void ParticleEmitter::buildVertices(std::vector<SDL_Vertex>& vertices) const {
+    // Каждая частица - квад из 4 вершин
+    vertices.resize(alive * 4);
+
+    const float half = config.size * 0.5f;
+    const SDL_FPoint noTex = {0.0f, 0.0f};
+    for(size_t i = 0; i < alive; i++) {
+        SDL_Color color = config.color;
+        color.a = static_cast<Uint8>(config.color.a * alpha[i]);
+
+        float left = posX[i] - half;
+        float right = posX[i] + half;
+        float top = posY[i] - half;
+        float bottom = posY[i] + half;
+
+        SDL_Vertex* v = &vertices[i * 4];
+        v[0] = {{left, top}, color, noTex};
+        v[1] = {{right, top}, color, noTex};
+        v[2] = {{right, bottom}, color, noTex};
+        v[3] = {{left, bottom}, color, noTex};
+    }
+}
+
+void ParticleEmitter::renderBatch(SDL_Renderer* renderer, const std::vector<SDL_Vertex>& vertices, std::vector<int>& indices) {
+    if(vertices.empty()) return;
+
+    // Индексы квадов одинаковы для всех эмиттеров, буфер только растет
+    size_t quads = vertices.size() / 4;
+    for(size_t i = indices.size() / 6; i < quads; i++) {
+        int base = static_cast<int>(i * 4);
+        indices.insert(indices.end(), {base, base + 1, base + 2, base + 2, base + 3, base});
+    }
+
+    // Один вызов отрисовки на весь эмиттер
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderGeometry(renderer, nullptr,
+        vertices.data(), static_cast<int>(vertices.size()),
+        indices.data(), static_cast<int>(quads * 6));
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+}
@@ -0,0 +1,69 @@
+#ifndef ParticleSystem_hpp
+#define ParticleSystem_hpp
+
+#include "SDL2/SDL.h"
+#include <string>
+#include <vector>
+
+struct ParticleEmitterConfig {
+    std::string name;
+    int capacity = 1024;        // Максимум частиц в пуле, память выделяется один раз
+    float rate = 100.0f;        // Частиц в секунду
+    SDL_FRect area = {0, 0, 0, 0};  // Прямоугольник появления частиц
+    bool followViewport = false;    // Область растягивается на ширину окна
+    float minVelX = 0.0f, maxVelX = 0.0f;
+    float minVelY = 0.0f, maxVelY = 0.0f;
+    float gravityX = 0.0f, gravityY = 0.0f;
+    float minLife = 1.0f, maxLife = 1.0f;
+    float size = 2.0f;
+    SDL_Color color = {255, 255, 255, 255};
+    bool fade = true;           // Прозрачность уменьшается к концу жизни частицы
+    bool active = true;
+    Uint32 seed = 1;
+};
+
+// Эмиттер частиц с пулом в виде структуры массивов (SoA).
+// Обновление идет по 4 частицы за раз (SSE), вершины собираются в потоке симуляции,
+// отрисовка - одним вызовом SDL_RenderGeometry на эмиттер.
+class ParticleEmitter {
+public:
+    explicit ParticleEmitter(const ParticleEmitterConfig& config);
+
+    void update(float deltaTime);
+    void buildVertices(std::vector<SDL_Vertex>& vertices) const;
+    // indices - буфер индексов квадов у владельца отрисовки, общий для всех эмиттеров;
+    // дополняется до нужного числа квадов и переиспользуется между кадрами
+    static void renderBatch(SDL_Renderer* renderer, const std::vector<SDL_Vertex>& vertices, std::vector<int>& indices);
+    void burst(int count);
+    void setActive(bool enabled) { config.active = enabled; }
+    void setViewport(int width, int height);
+    void clear() { alive = 0; }
+
+    const std::string& getName() const { return config.name; }
+    bool isActive() const { return config.active; }
+    size_t getAliveCount() const { return alive; }
+    size_t getCapacity() const { return capacity; }
+
+private:
+    ParticleEmitterConfig config;
+    size_t capacity;
+    size_t alive;
+    float spawnAccumulator;
+    Uint32 rngState;
+
+    // Пул частиц: каждое поле в отдельном непрерывном массиве
+    std::vector<float> posX;
+    std::vector<float> posY;
+    std::vector<float> velX;
+    std::vector<float> velY;
+    std::vector<float> life;
+    std::vector<float> invMaxLife;
+    std::vector<float> alpha;
+
+    void spawn(size_t count);
+    void integrate(float deltaTime);
+    void removeDead();
+    float randomRange(float min, float max);
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "Pathfinder.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+const int Pathfinder::NEIGHBOURS[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+bool FlowField::nextCell(int row, int col, std::pair<int, int>& next) const {
+    if(row < 0 || row >= rows || col < 0 || col >= cols) return false;
+    const int index = row * cols + col;
+    if(distance[index] == UNREACHABLE || distance[index] == 0) return false;
+    const int* step = Pathfinder::NEIGHBOURS[direction[index]];
+    next = {row + step[0], col + step[1]};
+    return true;
+}
+
+Pathfinder::Pathfinder()
+    : grid(nullptr), blockingLayers(0), rows(0), cols(0), generation(0), useCounter(0) {}
+
+void Pathfinder::setGrid(const CollisionGrid* collisionGrid, uint32_t layers, int newRows, int newCols) {
+    grid = collisionGrid;
+    blockingLayers = layers;
+    rows = std::max(newRows, 0);
+    cols = std::max(newCols, 0);
+
+    const size_t cells = static_cast<size_t>(rows) * cols;
+    gScore.assign(cells, 0);
+    parent.assign(cells, -1);
+    visited.assign(cells, 0);
+    closed.assign(cells, 0);
+    generation = 0;
+    flowFields.clear();
+}
+
+bool Pathfinder::findPath(std::pair<int, int> start, std::pair<int, int> goal,
+                          std::vector<std::pair<int, int>>& path) {
+    path.clear();
+    // Стартовая клетка может быть занята (актер стоит на краю препятствия), выходить из нее можно
+    if(start.first < 0 || start.first >= rows || start.second < 0 || start.second >= cols) return false;
+    if(isBlocked(goal.first, goal.second)) return false;
+    if(start == goal) return true;
+
+    // При переполнении поколения начинаем с чистых меток
+    if(++generation == 0) {
+        std::fill(visited.begin(), visited.end(), 0);
+        std::fill(closed.begin(), closed.end(), 0);
+        generation = 1;
+    }
+
+    auto heuristic = [&goal](int row, int col) {
+        return static_cast<uint32_t>(std::abs(row - goal.first) + std::abs(col - goal.second));
+    };
+    // Меньшее f выше, при равных f - ближе к цели
+    auto heapCompare = [](const OpenNode& a, const OpenNode& b) {
+        return a.f > b.f || (a.f == b.f && a.h > b.h);
+    };
+
+    const int startIndex = start.first * cols + start.second;
+    const int goalIndex = goal.first * cols + goal.second;
+    gScore[startIndex] = 0;
+    parent[startIndex] = -1;
+    visited[startIndex] = generation;
+
+    openHeap.clear();
+    uint32_t h = heuristic(start.first, start.second);
+    openHeap.push_back({h, h, startIndex});
+
+    while(!openHeap.empty()) {
+        std::pop_heap(openHeap.begin(), openHeap.end(), heapCompare);
+        const int current = openHeap.back().index;
+        openHeap.pop_back();
+
+        if(closed[current] == generation) continue;  // Устаревшая запись в куче
+        closed[current] = generation;
+
+        if(current == goalIndex) {
+            for(int index = goalIndex; index != startIndex; index = parent[index]) {
+                path.emplace_back(index / cols, index % cols);
+            }
+            std::reverse(path.begin(), path.end());
+            return true;
+        }
+
+        const int row = current / cols;
+        const int col = current % cols;
+        const uint32_t g = gScore[current] + 1;
+        for(const auto& step : NEIGHBOURS) {
+            const int nRow = row + step[0];
+            const int nCol = col + step[1];
+            if(isBlocked(nRow, nCol)) continue;
+
+            const int next = nRow * cols + nCol;
+            if(closed[next] == generation) continue;
+            if(visited[next] == generation && gScore[next] <= g) continue;
+
+            visited[next] = generation;
+            gScore[next] = g;
+            parent[next] = current;
+            uint32_t nh = heuristic(nRow, nCol);
+            openHeap.push_back({g + nh, nh, next});
+            std::push_heap(openHeap.begin(), openHeap.end(), heapCompare);
+        }
+    }
+    return false;
+}
+
+const FlowField* Pathfinder::getFlowField(std::pair<int, int> goal) {
+    if(isBlocked(goal.first, goal.second)) return nullptr;
+
+    for(auto& field : flowFields) {
+        if(field.goal == goal) {
+            field.lastUsed = ++useCounter;
+            return &field;
+        }
+    }
+
+    if(static_cast<int>(flowFields.size()) >= MAX_FLOW_FIELDS) {
+        // Вытесняем давно не использованное поле, его память переиспользуется
+        auto oldest = std::min_element(flowFields.begin(), flowFields.end(),
+            [](const FlowField& a, const FlowField& b) { return a.lastUsed < b.lastUsed; });
+        std::swap(*oldest, flowFields.back());
+    } else {
+        flowFields.emplace_back();
+    }
+
+    FlowField& field = flowFields.back();
+    field.goal = goal;
+    field.lastUsed = ++useCounter;
+    buildFlowField(field);
+    return &field;
+}
+
+void Pathfinder::buildFlowField(FlowField& field) {
+    field.rows = rows;
+    field.cols = cols;
+    const size_t cells = static_cast<size_t>(rows) * cols;
+    field.distance.assign(cells, FlowField::UNREACHABLE);
+    field.direction.assign(cells, 0);
+
+    // Все ходы одной стоимости, поэтому достаточно BFS от цели
+    bfsQueue.clear();
+    const int goalIndex = field.goal.first * cols + field.goal.second;
+    field.distance[goalIndex] = 0;
+    bfsQueue.push_back(goalIndex);
+
+    for(size_t head = 0; head < bfsQueue.size(); head++) {
+        const int current = bfsQueue[head];
+        const int row = current / cols;
+        const int col = current % cols;
+        const uint32_t d = field.distance[current] + 1;
+        for(int n = 0; n < 4; n++) {
+            const int nRow = row + NEIGHBOURS[n][0];
+            const int nCol = col + NEIGHBOURS[n][1];
+            if(isBlocked(nRow, nCol)) continue;
+
+            const int next = nRow * cols + nCol;
+            if(field.distance[next] != FlowField::UNREACHABLE) continue;
+
+            field.distance[next] = d;
+            // Сосед next -> current - обратное направление (0<->1, 2<->3)
+            field.direction[next] = static_cast<uint8_t>(n ^ 1);
+            bfsQueue.push_back(next);
+        }
+    }
+}
+
+bool Pathfinder::affectsField(const FlowField& field, int row, int col) const {
+    const int index = row * cols + col;
+    if(isBlocked(row, col)) {
+        // Закрылась клетка, через которую шли пути
+        return field.distance[index] != FlowField::UNREACHABLE;
+    }
+    // Открылась клетка рядом с достижимой областью - могут появиться короткие пути
+    for(const auto& step : NEIGHBOURS) {
+        const int nRow = row + step[0];
+        const int nCol = col + step[1];
+        if(nRow < 0 || nRow >= rows || nCol < 0 || nCol >= cols) continue;
+        if(field.distance[nRow * cols + nCol] != FlowField::UNREACHABLE) return true;
+    }
+    return false;
+}
+
+void Pathfinder::setMaskCells(std::vector<uint8_t> blocked, int newMaskRows, int newMaskCols) {
+    maskCells = std::move(blocked);
+    maskRows = maskCells.empty() ? 0 : newMaskRows;
+    maskCols = maskCells.empty() ? 0 : newMaskCols;
+    flowFields.clear();
+}
+
+void Pathfinder::onCellChanged(int row, int col) {
+    if(row < 0 || row >= rows || col < 0 || col >= cols) return;
+
+    // Поля, которых изменение не касается, остаются в кэше
+    flowFields.erase(std::remove_if(flowFields.begin(), flowFields.end(),
+        [&](const FlowField& field) { return affectsField(field, row, col); }),
+        flowFields.end());
+}
@@ -0,0 +1,94 @@
+#ifndef Pathfinder_hpp
+#define Pathfinder_hpp
+
+#include "CollisionGrid.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Поле направлений к одной цели: для каждой клетки - куда шагать дальше.
+// Одно поле обслуживает любое количество актеров, идущих к той же цели.
+struct FlowField {
+    static constexpr uint32_t UNREACHABLE = ~uint32_t(0);
+
+    int rows = 0;
+    int cols = 0;
+    std::pair<int, int> goal = {0, 0};  // {row, col}
+    std::vector<uint32_t> distance;     // Шагов до цели, UNREACHABLE - пути нет
+    std::vector<uint8_t> direction;     // Индекс соседа, см. Pathfinder::NEIGHBOURS
+    uint64_t lastUsed = 0;
+
+    // Следующая клетка на пути к цели; false, если клетка недостижима или уже цель
+    bool nextCell(int row, int col, std::pair<int, int>& next) const;
+};
+
+// Поиск пути по сетке сцены с учетом коллизий.
+// A* для одиночных запросов и кэш полей направлений для множества актеров с общей целью.
+// Ходы только по 4 направлениям, как и проверка клеток в SceneManager.
+// Все буферы переиспользуются между запросами, после прогрева поиск не аллоцирует память.
+class Pathfinder {
+public:
+    static const int MAX_FLOW_FIELDS = 8;  // Сколько полей держим в кэше, лишние вытесняются по давности
+    static const int NEIGHBOURS[4][2];     // {dRow, dCol}
+
+    Pathfinder();
+
+    // Сетка коллизий и область поиска (обычно - видимая сетка); сбрасывает кэш
+    void setGrid(const CollisionGrid* grid, uint32_t blockingLayers, int rows, int cols);
+
+    // Путь от start до goal без стартовой клетки; false, если пути нет
+    bool findPath(std::pair<int, int> start, std::pair<int, int> goal, std::vector<std::pair<int, int>>& path);
+
+    // Поле к цели из кэша или построенное заново.
+    // Указатель действителен до следующего вызова getFlowField или инвалидации.
+    const FlowField* getFlowField(std::pair<int, int> goal);
+
+    // Клетки, закрытые попиксельной маской коллизий: blocked[row * maskCols + col] != 0.
+    // Пустой вектор - маски нет. Сбрасывает кэш полей
+    void setMaskCells(std::vector<uint8_t> blocked, int maskRows, int maskCols);
+
+    // Вызывается после изменения клетки: выбрасывает только поля, на которые изменение влияет
+    void onCellChanged(int row, int col);
+    void invalidateAll() { flowFields.clear(); }
+
+    bool isBlocked(int row, int col) const {
+        if(row < 0 || row >= rows || col < 0 || col >= cols) return true;
+        if(row < maskRows && col < maskCols && maskCells[row * maskCols + col]) return true;
+        return grid && grid->testAny(row, col, blockingLayers);
+    }
+
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+
+private:
+    struct OpenNode {
+        uint32_t f;
+        uint32_t h;
+        int index;
+    };
+
+    const CollisionGrid* grid;
+    uint32_t blockingLayers;
+    int rows;
+    int cols;
+    std::vector<uint8_t> maskCells;
+    int maskRows = 0;
+    int maskCols = 0;
+
+    // Состояние A*: метка поколения избавляет от очистки массивов между запросами
+    std::vector<uint32_t> gScore;
+    std::vector<int> parent;
+    std::vector<uint32_t> visited;  // Поколение, в котором клетка получила gScore
+    std::vector<uint32_t> closed;   // Поколение, в котором клетка закрыта
+    std::vector<OpenNode> openHeap;
+    uint32_t generation;
+
+    std::vector<FlowField> flowFields;
+    std::vector<int> bfsQueue;
+    uint64_t useCounter;
+
+    void buildFlowField(FlowField& field);
+    bool affectsField(const FlowField& field, int row, int col) const;
+};
+
+#endif
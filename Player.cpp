@@ -1,17 +1,17 @@
 #include "Player.hpp"
-#include "SDL2/SDL_image.h"
 #include "SceneManager.hpp"  
 #include <iostream>  // Add this line
 
 Player::Player() : 
     x(0),
     y(0),
+    previousX(0),
+    previousY(0),
     velocityX(0),
     velocityY(0),
     speed(100.0f), // Reduced from 200.0f to 100.0f pixels per second
     color{0, 0, 255, 255},
     size(0),
-    spriteSheet(nullptr),
     frameWidth(48),  // Changed from 32 to 48
     frameHeight(48), // Changed from 32 to 48
     currentFrame(0),
@@ -27,28 +27,13 @@ Player::Player() :
 }
 
 Player::~Player() {
-    if(spriteSheet) {
-        SDL_DestroyTexture(spriteSheet);
-    }
 }
 
-bool Player::loadSprite(SDL_Renderer* renderer, const std::string& path) {
-    if(spriteSheet) {
-        SDL_DestroyTexture(spriteSheet);
-        spriteSheet = nullptr;
-    }
-    
-    SDL_Surface* surface = IMG_Load(path.c_str());
-    if(!surface) {
-        SDL_Log("Failed to load sprite sheet: %s", IMG_GetError());
-        return false;
-    }
-    
-    spriteSheet = SDL_CreateTextureFromSurface(renderer, surface);
-    SDL_FreeSurface(surface);
-    
+bool Player::loadSprite(AssetManager& assets, const std::string& path) {
+    // Тот же скин в следующей сцене берется из кэша, старая ссылка отпускается после новой
+    spriteSheet = assets.load(path);
     if(!spriteSheet) {
-        SDL_Log("Failed to create texture: %s", SDL_GetError());
+        SDL_Log("Failed to load sprite sheet: %s", path.c_str());
         return false;
     }
     
@@ -58,6 +43,9 @@ bool Player::loadSprite(SDL_Renderer* renderer, const std::string& path) {
 void Player::setPosition(float newX, float newY, int newSize) {
     x = newX;
     y = newY;
+    // Телепорт не интерполируем
+    previousX = x;
+    previousY = y;
     size = newSize;
     
     // Adjust position and size for scale
@@ -113,43 +101,27 @@ void Player::setDirection(float dx, float dy) {
 }
 
 void Player::update(float deltaTime) {
-    if (!movementEnabled) {
+    previousX = x;
+    previousY = y;
+
+    if (!movementEnabled && !autopilot) {
         velocityX = 0;
         velocityY = 0;
         updateAnimation(deltaTime);
         return;
     }
 
-    float newX = x + velocityX * speed * deltaTime;
-    float newY = y;
-    
-    // Get player collision points
-    float centerY = y + size + size/2 - 4;
-    float leftX = newX + size/4;
-    float centerX = newX + size/2;
-    float rightX = newX + size*3/4;
-    
-    // Проверяем коллизию по X
-    if(!checkCollision(leftX, centerY) && 
-       !checkCollision(centerX, centerY) && 
-       !checkCollision(rightX, centerY)) {
-        x = newX;
+    // Сдвигаем по осям по очереди: упершись в стену по одной оси, игрок скользит вдоль нее по другой.
+    // Свип возвращает долю шага до касания, поэтому тонкие препятствия не проскакиваются
+    // и игрок встает вплотную к стене.
+    float dx = velocityX * speed * deltaTime;
+    if(dx != 0.0f) {
+        x += dx * (sceneManager ? sceneManager->sweepX(getFeetBox(), dx) : 1.0f);
     }
 
-    // Проверяем коллизию по Y
-    newX = x;
-    newY = y + velocityY * speed * deltaTime;
-    
-    // Обновляем Y-координаты для точек
-    centerY = newY + size + size/2 - 4;
-    leftX = x + size/4;
-    centerX = x + size/2;
-    rightX = x + size*3/4;
-    
-    if(!checkCollision(leftX, centerY) && 
-       !checkCollision(centerX, centerY) && 
-       !checkCollision(rightX, centerY)) {
-        y = newY;
+    float dy = velocityY * speed * deltaTime;
+    if(dy != 0.0f) {
+        y += dy * (sceneManager ? sceneManager->sweepY(getFeetBox(), dy) : 1.0f);
     }
     
     rect.x = (int)(x - (rect.w - size) / 2);
@@ -170,13 +142,9 @@ void Player::update(float deltaTime) {
     updateAnimation(deltaTime);
 }
 
-bool Player::checkCollision(float newX, float newY) const {
-    if(!sceneManager) return false;
-    bool collision = sceneManager->isCollision(newX, newY);
-    if(collision) {
-        std::cout << "Collision at pixel: (" << newX << ", " << newY << ")" << std::endl;
-    }
-    return collision;
+SDL_FRect Player::getFeetBox() const {
+    // Линия ног: от четверти до трех четвертей ширины, на 4 пикселя выше низа спрайта
+    return {x + size/4, y + size + size/2 - 4, static_cast<float>(size*3/4 - size/4), 0.0f};
 }
 
 void Player::updateAnimation(float deltaTime) {
@@ -192,9 +160,30 @@ void Player::updateAnimation(float deltaTime) {
     }
 }
 
-void Player::render(SDL_Renderer* renderer) const {
-    if(spriteSheet) {
-        SDL_RenderCopy(renderer, spriteSheet, &srcRect, &rect);
+void Player::captureRenderState(PlayerRenderState& state) const {
+    state.texture = spriteSheet.get();
+    state.srcRect = srcRect;
+    state.dstRect = rect;
+    state.color = color;
+    state.x = x;
+    state.y = y;
+    state.previousX = previousX;
+    state.previousY = previousY;
+    state.size = size;
+}
+
+void Player::render(SDL_Renderer* renderer, const PlayerRenderState& state, float alpha) {
+    const float x = state.previousX + (state.x - state.previousX) * alpha;
+    const float y = state.previousY + (state.y - state.previousY) * alpha;
+    const int size = state.size;
+
+    // Сдвигаем прямоугольник спрайта на интерполированную позицию
+    SDL_Rect dstRect = state.dstRect;
+    dstRect.x += static_cast<int>(x) - static_cast<int>(state.x);
+    dstRect.y += static_cast<int>(y) - static_cast<int>(state.y);
+
+    if(state.texture) {
+        SDL_RenderCopy(renderer, state.texture, &state.srcRect, &dstRect);
         
         // Отрисовка точек коллизии (для отладки)
         SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
@@ -231,7 +220,7 @@ void Player::render(SDL_Renderer* renderer) const {
         SDL_RenderFillRect(renderer, &point);
     } else {
         // Fallback to rectangle rendering
-        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-        SDL_RenderFillRect(renderer, &rect);
+        SDL_SetRenderDrawColor(renderer, state.color.r, state.color.g, state.color.b, state.color.a);
+        SDL_RenderFillRect(renderer, &dstRect);
     }
 }
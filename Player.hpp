@@ -2,6 +2,8 @@
 #define Player_hpp
 
 #include "SDL2/SDL.h"
+#include "RenderState.hpp"
+#include "AssetManager.hpp"
 #include <string>
 
 class SceneManager;  // Forward declaration
@@ -13,15 +15,22 @@ public:
     
     void setPosition(float newX, float newY, int size);
     void update(float deltaTime);
-    void render(SDL_Renderer* renderer) const;
+    void captureRenderState(PlayerRenderState& state) const;
+    // alpha - доля прошедшего времени между двумя последними тиками симуляции
+    static void render(SDL_Renderer* renderer, const PlayerRenderState& state, float alpha);
     
     void setVelocity(float vx, float vy) { velocityX = vx; velocityY = vy; }
     float getX() const { return x; }
     float getY() const { return y; }
+    float getPreviousX() const { return previousX; }
+    float getPreviousY() const { return previousY; }
     void setMovementEnabled(bool enabled) { movementEnabled = enabled; }
-    bool loadSprite(SDL_Renderer* renderer, const std::string& path);
+    // Движением управляет сцена (например, идем по пути в кат-сцене), даже если управление отключено
+    void setAutopilot(bool enabled) { autopilot = enabled; }
+    bool loadSprite(AssetManager& assets, const std::string& path);
     void setAnimation(const std::string& state);
     void setSpeed(float newSpeed) { speed = newSpeed; }
+    float getSpeed() const { return speed; }
     void setCollisionChecker(const SceneManager* manager) { sceneManager = manager; }
     int getSize() const { return size; }
     float getScale() const { return scale; }
@@ -36,12 +45,13 @@ public:
 private:
     SDL_Rect rect;
     float x, y;
+    float previousX, previousY;  // Позиция на предыдущем тике, для интерполяции при отрисовке
     float velocityX, velocityY;
     float speed;
     SDL_Color color;
     int size;
 
-    SDL_Texture* spriteSheet;
+    TextureHandle spriteSheet;  // Скин, общий для сцен с тем же игроком
     SDL_Rect srcRect;  // Source rectangle for sprite animation
     int frameWidth;
     int frameHeight;
@@ -54,9 +64,10 @@ private:
     Direction lastDirection;
     float scale;
     bool movementEnabled = true;
+    bool autopilot = false;
 
     const SceneManager* sceneManager = nullptr;
-    bool checkCollision(float newX, float newY) const;
+    SDL_FRect getFeetBox() const;
     void updateAnimation(float deltaTime);
     void setDirection(float dx, float dy);
 };
@@ -0,0 +1,71 @@
+#include "RenderQueue.hpp"
+
+RenderQueue::RenderQueue()
+    : renderThread(std::this_thread::get_id()), threaded(false), simulationSequence(0) {}
+
+void RenderQueue::bindRenderThread() {
+    renderThread = std::this_thread::get_id();
+}
+
+void RenderQueue::run(const std::function<void()>& function) {
+    // В потоке рендера (и в однопоточном режиме) выполняем сразу
+    if(onRenderThread()) {
+        function();
+        return;
+    }
+
+    Task task{&function, false};
+    std::unique_lock<std::mutex> lock(mutex);
+    tasks.push_back(&task);
+    completed.wait(lock, [&task] { return task.done; });
+}
+
+void RenderQueue::destroyTexture(SDL_Texture* texture) {
+    if(!texture) return;
+
+    // Даже в потоке рендера нельзя удалять сразу: текущий снимок может ссылаться на текстуру
+    if(!threaded) {
+        SDL_DestroyTexture(texture);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingDestroy.emplace_back(simulationSequence.load(std::memory_order_acquire), texture);
+}
+
+void RenderQueue::process(Uint64 renderedSequence) {
+    std::vector<Task*> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(tasks);
+
+        // Текстура, отпущенная в тике N, не попадает в снимки N и новее
+        size_t kept = 0;
+        for(auto& entry : pendingDestroy) {
+            if(entry.first <= renderedSequence) {
+                SDL_DestroyTexture(entry.second);
+            } else {
+                pendingDestroy[kept++] = entry;
+            }
+        }
+        pendingDestroy.resize(kept);
+    }
+
+    if(ready.empty()) return;
+
+    for(Task* task : ready) {
+        (*task->function)();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(Task* task : ready) {
+            task->done = true;
+        }
+    }
+    completed.notify_all();
+}
+
+void RenderQueue::flush() {
+    process(~static_cast<Uint64>(0));
+}
@@ -0,0 +1,61 @@
+#ifndef RenderQueue_hpp
+#define RenderQueue_hpp
+
+#include "SDL2/SDL.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Очередь задач для потока рендера.
+// SDL_Renderer можно трогать только из потока, который его создал, поэтому
+// загрузка текстур из потока симуляции передается сюда и выполняется между кадрами.
+// Удаление текстур откладывается, пока рендер не перейдет на снимок,
+// сделанный уже после удаления, - старые снимки еще могут на них ссылаться.
+class RenderQueue {
+public:
+    RenderQueue();
+
+    // Вызывается из потока рендера один раз при старте
+    void bindRenderThread();
+
+    // Пока поток симуляции не запущен, текстуры удаляются сразу
+    void setThreaded(bool enabled) { threaded = enabled; }
+
+    // Выполняет задачу в потоке рендера и ждет ее завершения
+    void run(const std::function<void()>& task);
+
+    // Откладывает SDL_DestroyTexture до тех пор, пока текстура гарантированно не используется
+    void destroyTexture(SDL_Texture* texture);
+
+    // Поток симуляции: номер снимка, который будет опубликован в конце текущего тика
+    void setSimulationSequence(Uint64 sequence) { simulationSequence.store(sequence, std::memory_order_release); }
+
+    // Поток рендера: выполняет ожидающие задачи и удаляет текстуры,
+    // которые не нужны снимкам с номером renderedSequence и новее
+    void process(Uint64 renderedSequence);
+
+    // Поток рендера при завершении: выполняет все, что осталось
+    void flush();
+
+private:
+    struct Task {
+        const std::function<void()>* function;
+        bool done;
+    };
+
+    std::thread::id renderThread;
+    bool threaded;
+    std::atomic<Uint64> simulationSequence;
+    std::mutex mutex;
+    std::condition_variable completed;
+    std::vector<Task*> tasks;
+    std::vector<std::pair<Uint64, SDL_Texture*>> pendingDestroy;
+
+    bool onRenderThread() const { return std::this_thread::get_id() == renderThread; }
+};
+
+#endif
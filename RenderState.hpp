@@ -0,0 +1,74 @@
+#ifndef RenderState_hpp
+#define RenderState_hpp
+
+#include "SDL2/SDL.h"
+#include <string>
+#include <vector>
+
+// Неизменяемый снимок всего, что нужно для отрисовки кадра.
+// Заполняется потоком симуляции, читается только потоком рендера.
+// Для движущихся элементов хранится и предыдущее значение, рендер интерполирует между ними.
+// Векторы переиспользуются между кадрами, поэтому после прогрева аллокаций нет.
+
+struct LayerRenderState {
+    SDL_Texture* texture;
+    SDL_Rect dstRect;
+    Uint8 opacity;
+};
+
+struct PlayerRenderState {
+    SDL_Texture* texture = nullptr;
+    SDL_Rect srcRect = {0, 0, 0, 0};
+    SDL_Rect dstRect = {0, 0, 0, 0};
+    SDL_Color color = {0, 0, 255, 255};
+    float x = 0.0f;
+    float y = 0.0f;
+    float previousX = 0.0f;
+    float previousY = 0.0f;
+    int size = 0;
+};
+
+struct DialogRenderState {
+    bool active = false;
+    bool hasLine = false;
+    float y = 0.0f;
+    float previousY = 0.0f;
+    int screenWidth = 0;
+    SDL_Texture* box = nullptr;
+    SDL_Texture* avatar = nullptr;
+    std::string title;
+    std::string text;          // Строка целиком, видимую часть рендер считает по времени печати
+    uint64_t groupSerial = 0;  // Меняется со сменой группы: кэш раскладок строк пора сбросить
+    uint32_t lineIndex = 0;
+    float revealTime = 0.0f;   // Время печати строки на этом и предыдущем тике
+    float previousRevealTime = 0.0f;
+    float revealDelay = 0.0f;  // Символ i появляется в (i + 1) * revealDelay; 0 - вся строка сразу
+};
+
+struct RenderState {
+    Uint64 sequence = 0;  // Номер тика симуляции, в котором сделан снимок
+    double timestamp = 0.0;  // Время публикации снимка (FramePacer::now)
+    bool valid = false;
+
+    bool staticScene = false;
+    bool showVideo = false;
+    SDL_Color backgroundColor = {0, 0, 0, 255};
+    std::vector<LayerRenderState> layers;
+
+    bool showGrid = false;
+    int gridRows = 0;
+    int gridCols = 0;
+    int gridSize = 0;
+
+    PlayerRenderState player;
+    std::vector<SDL_Rect> collisionRects;
+    std::vector<SDL_Rect> scriptCellRects;
+    std::vector<std::vector<SDL_Vertex>> particles;  // Готовые вершины, по буферу на эмиттер
+    DialogRenderState dialog;
+
+    float fadeAlpha = 0.0f;
+    float previousFadeAlpha = 0.0f;
+    SDL_Rect fadeRect = {0, 0, 0, 0};
+};
+
+#endif
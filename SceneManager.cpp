@@ -1,14 +1,51 @@
 #include "SceneManager.hpp"
+#include "RenderQueue.hpp"
 #include <iostream>
 
-SceneManager::SceneManager(SDL_Renderer* renderer) : renderer(renderer) {
+// Проход ведущей гранью lead на delta по клеткам размера cellSize.
+// blocked(cell) проверяет очередной ряд клеток, в который входит грань.
+// Возвращает долю delta до первой занятой клетки или 1, если путь свободен.
+template<typename Blocked>
+static float sweepCells(float lead, float delta, float cellSize, Blocked blocked) {
+    // Грань, стоящая на границе с погрешностью округления, считается стоящей ровно на ней
+    const float EPS = 1e-3f;
+    if(delta > 0.0f) {
+        for(int cell = static_cast<int>(std::ceil((lead - EPS) / cellSize)); ; cell++) {
+            float boundary = cell * cellSize;
+            if(boundary >= lead + delta) break;
+            if(blocked(cell)) return std::max(0.0f, (boundary - lead) / delta);
+        }
+    } else if(delta < 0.0f) {
+        for(int cell = static_cast<int>(std::floor((lead + EPS) / cellSize)) - 1; ; cell--) {
+            float boundary = (cell + 1) * cellSize;
+            if(boundary <= lead + delta) break;
+            if(blocked(cell)) return std::max(0.0f, (boundary - lead) / delta);
+        }
+    }
+    return 1.0f;
+}
+
+// Диапазон клеток, которые занимает отрезок [from, from + length]
+static void cellSpan(float from, float length, float cellSize, int& first, int& last) {
+    const float EPS = 1e-3f;
+    first = static_cast<int>(std::floor((from + EPS) / cellSize));
+    last = std::max(first, static_cast<int>(std::floor((from + length - EPS) / cellSize)));
+}
+
+SceneManager::SceneManager(SDL_Renderer* renderer, RenderQueue* renderQueue)
+    : renderer(renderer), renderQueue(renderQueue), assets(renderer, renderQueue) {
     backgroundColor = {255, 255, 255, 255};
     videoPlayer = new VideoPlayer(renderer);
     currentSceneType = SceneType::STATIC;
-    backgroundTexture = nullptr;
     gridRows = 0;
     gridCols = 0;
     dialogSystem = nullptr; // Сначала nullptr
+    scripts.setExecutor([this](const ScriptProgram& program, const ScriptInstruction& ins) {
+        return executeInstruction(program, ins);
+    });
+    // Размер вывода запрашиваем один раз, дальше он приходит через setOutputSize
+    SDL_GetRendererOutputSize(renderer, &outputWidth, &outputHeight);
+    fadeRect = {0, 0, outputWidth, outputHeight};
     calculateGrid();
 }
 
@@ -23,7 +60,32 @@ void SceneManager::setGamePath(const std::string& path) {
     gamePath = path;
     // Создаем DialogSystem после установки пути
     if(!dialogSystem) {
-        dialogSystem = new DialogSystem(renderer, gamePath);
+        dialogSystem = new DialogSystem(renderer, gamePath, renderQueue, &assets);
+        dialogSystem->setViewport(outputWidth, outputHeight);
+    }
+}
+
+void SceneManager::enableHotReload() {
+    if(fileWatcher.start(gamePath)) {
+        std::cout << "Hot reload: watching " << gamePath << std::endl;
+    }
+}
+
+void SceneManager::setOutputSize(int width, int height) {
+    if(width == outputWidth && height == outputHeight) return;
+
+    outputWidth = width;
+    outputHeight = height;
+    fadeRect = {0, 0, outputWidth, outputHeight};
+
+    // Всё, что зависит от размера окна, пересчитываем здесь один раз
+    calculateGrid();
+    updateLayerPlacement();
+    if(dialogSystem) {
+        dialogSystem->setViewport(outputWidth, outputHeight);
+    }
+    for(auto& emitter : particleEmitters) {
+        emitter.setViewport(outputWidth, outputHeight);
     }
 }
 
@@ -38,6 +100,7 @@ bool SceneManager::loadScene(const std::string& sceneName) {
 
     try {
         file >> currentScene;
+        currentSceneName = sceneName;
         
         std::string sceneType = currentScene["type"];
         if(sceneType == "video") {
@@ -75,114 +138,147 @@ void SceneManager::loadStaticScene(const json& sceneData) {
     
     // Инициализируем начальное затемнение если оно запрошено
     fadeAlpha = sceneData.value("fadeAtStart", false) ? 1.0f : 0.0f;
+    previousFadeAlpha = fadeAlpha;
     
     showGrid = sceneData.value("showGrid", false);
     loadLayers(sceneData);
     loadCollisions(sceneData);
     loadScriptGroups(sceneData);
     loadScriptCells(sceneData);
+    loadWatchers(sceneData);
     calculateGrid();
     initializePlayer(sceneData);
     loadDialogGroups(sceneData);
+    loadParticles(sceneData);
     loadInitialScript(sceneData); // Загружаем начальный скрипт
     loadGlobalVars(sceneData); // Загружаем глобальные переменные
+    applyCollisionBindings(-1); // Клетки, привязанные к переменным
+    linkScene();
     
-    // Сразу запускаем начальный скрипт если он есть
-    if (!initialScript.commands.empty()) {
-        activeCommands = initialScript.commands;
+    // Сразу запускаем начальный скрипт. Триггеры клеток выполняются параллельно с ним
+    scripts.start(initialScript);
+    // Условия, истинные уже при входе в сцену, срабатывают сразу
+    for(auto& watcher : watchers) {
+        checkWatcher(watcher);
     }
+    journalResetPending = true;
 }
 
 void SceneManager::loadInitialScript(const json& sceneData) {
-    initialScript.commands.clear();
-    
-    if(sceneData.contains("InitialScript")) {
-        for(const auto& cmdData : sceneData["InitialScript"]) {
-            for(auto it = cmdData.begin(); it != cmdData.end(); ++it) {
-                ScriptCommand cmd;
-                cmd.command = it.key();
-                cmd.parameter = it.value();
-                initialScript.commands.push_back(cmd);
-            }
-        }
-    }
+    ScriptCompiler::compile(sceneData.value("InitialScript", json::array()), "InitialScript", initialScript, globalVars);
 }
 
 void SceneManager::loadBackgroundImage(const std::string& imagePath) {
-    SDL_Surface* surface = IMG_Load(imagePath.c_str());
-    if (surface) {
-        backgroundTexture = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_FreeSurface(surface);
-        if (!backgroundTexture) {
-            std::cout << "Failed to create texture from image: " << SDL_GetError() << std::endl;
-        }
-    } else {
-        std::cout << "Failed to load image: " << IMG_GetError() << std::endl;
-    }
+    backgroundTexture = assets.load(imagePath);
 }
 
 void SceneManager::cleanupBackground() {
-    if (backgroundTexture) {
-        SDL_DestroyTexture(backgroundTexture);
-        backgroundTexture = nullptr;
-    }
+    backgroundTexture.reset();
 }
 
 void SceneManager::cleanupLayers() {
-    for(auto& layer : layers) {
-        if(layer.texture) {
-            SDL_DestroyTexture(layer.texture);
-        }
-    }
+    // Текстуры отпускает менеджер ресурсов, когда на них не остается ссылок
     layers.clear();
 }
 
 void SceneManager::loadLayers(const json& sceneData) {
-    cleanupLayers();
-    if (!sceneData.contains("layers")) return;
+    // Новые слои собираются рядом со старыми: картинки, которые есть в обеих сценах, не перечитываются
+    std::vector<Layer> previousLayers;
+    previousLayers.swap(layers);
+    collisionMask.clear();
+    if (!sceneData.contains("layers")) {
+        updateLayerPlacement();  // Клетки старой маски больше не закрыты
+        return;
+    }
     for (const auto& layerData : sceneData["layers"]) {
         Layer layer;
         layer.zIndex = layerData.value("z", 0);
         layer.opacity = layerData.value("opacity", 255);
-        std::string imagePath = gamePath + "/image/" + layerData["image"].get<std::string>();
-        if (loadLayerImage(layer, imagePath)) {
-            layers.push_back(layer);
+        layer.image = layerData["image"].get<std::string>();
+        std::string imagePath = gamePath + "/image/" + layer.image;
+        // "collision": true - непрозрачные пиксели слоя становятся коллизией
+        layer.collisionAlpha = layerData.value("collision", false) ? layerData.value("collisionAlpha", 128) : -1;
+        if (loadLayerImage(layer, imagePath, layer.collisionAlpha)) {
+            layers.push_back(std::move(layer));
         }
     }
     // Sort layers by z-index
     std::sort(layers.begin(), layers.end(), 
         [](const Layer& a, const Layer& b) { return a.zIndex < b.zIndex; });
+    updateLayerPlacement();
 }
 
-bool SceneManager::loadLayerImage(Layer& layer, const std::string& imagePath) {
-    SDL_Surface* surface = IMG_Load(imagePath.c_str());
-    if (surface) {
-        // Создаем текстуру с фиксированным размером
-        layer.texture = SDL_CreateTextureFromSurface(renderer, surface);
-        // Сохраняем оригинальные размеры изображения
-        layer.width = surface->w;
-        layer.height = surface->h;
-        SDL_FreeSurface(surface);
-        if (!layer.texture) {
-            std::cout << "Failed to create texture from image: " << SDL_GetError() << std::endl;
+void SceneManager::updateLayerPlacement() {
+    // Центрируем слои относительно текущего размера вывода
+    for(auto& layer : layers) {
+        layer.dstRect.w = layer.width;
+        layer.dstRect.h = layer.height;
+        layer.dstRect.x = (outputWidth - layer.width) / 2;
+        layer.dstRect.y = (outputHeight - layer.height) / 2;
+    }
+    collisionMaskX = (outputWidth - collisionMask.getWidth()) / 2;
+    collisionMaskY = (outputHeight - collisionMask.getHeight()) / 2;
+    rasterizeCollisionMask();
+}
+
+void SceneManager::rasterizeCollisionMask() {
+    // Маска центрируется по окну, поэтому клетки пересчитываются при каждом ее перемещении.
+    // Клетка закрыта для поиска пути, если в ней есть хоть один твердый пиксель
+    std::vector<uint8_t> blocked;
+    if(!collisionMask.empty()) {
+        blocked.assign(static_cast<size_t>(gridRows) * gridCols, 0);
+        for(int row = 0; row < gridRows; row++) {
+            for(int col = 0; col < gridCols; col++) {
+                const int x = col * GRID_SIZE - collisionMaskX;
+                const int y = row * GRID_SIZE - collisionMaskY;
+                blocked[row * gridCols + col] = collisionMask.testRect(x, y, x + GRID_SIZE - 1, y + GRID_SIZE - 1);
+            }
+        }
+    }
+    pathfinder.setMaskCells(std::move(blocked), gridRows, gridCols);
+    // Идущий по пути игрок перестроит его на следующем тике, как после изменения сетки
+    playerPathVersion = ~uint64_t(0);
+}
+
+bool SceneManager::loadLayerImage(Layer& layer, const std::string& imagePath, int collisionAlpha) {
+    if (collisionAlpha < 0) {
+        layer.texture = assets.load(imagePath);
+    } else {
+        // Маске нужны пиксели: картинку читаем сами, текстура при промахе создается из нее же
+        SDL_Surface* surface = IMG_Load(imagePath.c_str());
+        if (!surface) {
+            std::cout << "Failed to load image: " << IMG_GetError() << std::endl;
             return false;
         }
-        return true;
+        if (!collisionMask.empty()) {
+            std::cout << "Collision mask already set, ignoring layer: " << imagePath << std::endl;
+        } else {
+            collisionMask.build(surface, static_cast<Uint8>(std::min(collisionAlpha, 255)));
+        }
+        layer.texture = assets.load(imagePath, surface);
+        SDL_FreeSurface(surface);
     }
-    std::cout << "Failed to load image: " << IMG_GetError() << std::endl;
-    return false;
+    if (!layer.texture) return false;
+    // Сохраняем оригинальные размеры изображения
+    layer.width = layer.texture.getWidth();
+    layer.height = layer.texture.getHeight();
+    return true;
 }
 
 void SceneManager::calculateGrid() {
     if(currentSceneType != SceneType::STATIC) {
         return;
     }
-    int w, h;
-    SDL_GetRendererOutputSize(renderer, &w, &h);
     // Пересчитываем размеры сетки под новый размер окна
-    gridCols = w / GRID_SIZE;
-    gridRows = h / GRID_SIZE;
+    gridCols = outputWidth / GRID_SIZE;
+    gridRows = outputHeight / GRID_SIZE;
     initializeGrid();
+    // Сетка коллизий только растет, чтобы не терять клетки при уменьшении окна
+    collisionGrid.resize(std::max(collisionGrid.getRows(), gridRows),
+                         std::max(collisionGrid.getCols(), gridCols));
+    // Ищем пути только в видимой сетке: за ее пределами isCollision считает все занятым
+    pathfinder.setGrid(&collisionGrid, PLAYER_BLOCKING_LAYERS, gridRows, gridCols);
+    rasterizeCollisionMask();
 }
 
 void SceneManager::initializeGrid() {
@@ -222,27 +318,38 @@ const GridCell* SceneManager::getCellAtPosition(int x, int y) const {
     return getCellAt(row, col);
 }
 
-void SceneManager::drawGrid() {
+void SceneManager::drawGrid(const RenderState& state) {
+    const int size = state.gridSize;
     SDL_SetRenderDrawColor(renderer, 128, 128, 128, 255);
     // Draw vertical lines
-    for(int col = 0; col <= gridCols; col++) {
-        int x = col * GRID_SIZE;
-        SDL_RenderDrawLine(renderer, x, 0, x, gridRows * GRID_SIZE);
+    for(int col = 0; col <= state.gridCols; col++) {
+        int x = col * size;
+        SDL_RenderDrawLine(renderer, x, 0, x, state.gridRows * size);
     }
     // Draw horizontal lines
-    for(int row = 0; row <= gridRows; row++) {
-        int y = row * GRID_SIZE;
-        SDL_RenderDrawLine(renderer, 0, y, gridCols * GRID_SIZE, y);
+    for(int row = 0; row <= state.gridRows; row++) {
+        int y = row * size;
+        SDL_RenderDrawLine(renderer, 0, y, state.gridCols * size, y);
     }
 }
 
 void SceneManager::update(float deltaTime) {
+    previousFadeAlpha = fadeAlpha;
+    assets.collect();  // Текстуры, декодированные в фоне
+    journalTick++;
+    journalStep = deltaTime;
+
+    if(fileWatcher.isActive()) {
+        checkHotReload();
+    }
+
     if(isPlayingVideo) {
         Uint32 currentTime = SDL_GetTicks();
         if(currentTime >= nextFrameTime) {
             if(!videoPlayer->decodeNextFrame()) {
                 isPlayingVideo = false;
                 videoPlayer->cleanup();
+                scripts.signal(ScriptEvent::VideoEnd);
                 return;
             }
             nextFrameTime = currentTime + videoPlayer->getFrameDelay();
@@ -253,76 +360,125 @@ void SceneManager::update(float deltaTime) {
     }
     
     if(currentSceneType == SceneType::STATIC && !isPlayingVideo) {
+        if(!playerPath.empty()) {
+            updatePlayerWalk(deltaTime);
+        }
         player.update(deltaTime);
-        checkPlayerInScriptCells();
+        sceneTime += deltaTime;
+        updateScriptTriggers();
+
+        for(auto& emitter : particleEmitters) {
+            emitter.update(deltaTime);
+        }
     }
     
-    updateActiveCommands(deltaTime);
+    scripts.update(deltaTime, globalVars);
+    retryPendingWatchers();
+    // Окончания затемнения и диалога будят ждущие скрипты на следующем тике
+    if(isFading && !updateFade(deltaTime)) {
+        scripts.signal(ScriptEvent::FadeEnd);
+    }
     
     if(dialogSystem) {
+        bool dialogWasActive = dialogSystem->isActive();
         dialogSystem->update(deltaTime);
+        if(dialogWasActive && !dialogSystem->isActive()) {
+            scripts.signal(ScriptEvent::DialogClosed);
+        }
+    }
+
+    if(collisionGrid.getVersion() != collisionDebugVersion) {
+        rebuildCollisionDebugRects();
+    }
+
+    if(currentSceneType == SceneType::STATIC) {
+        recordJournal();
+    }
+}
+
+void SceneManager::captureRenderState(RenderState& state) const {
+    state.staticScene = currentSceneType == SceneType::STATIC;
+    state.showVideo = isPlayingVideo;
+    state.backgroundColor = backgroundColor;
+
+    state.layers.clear();
+    for(const auto& layer : layers) {
+        state.layers.push_back({layer.texture.get(), layer.dstRect, layer.opacity});
+    }
+
+    state.showGrid = showGrid;
+    state.gridRows = gridRows;
+    state.gridCols = gridCols;
+    state.gridSize = GRID_SIZE;
+
+    player.captureRenderState(state.player);
+
+    state.collisionRects = collisionDebugRects;
+
+    state.scriptCellRects = scriptCellDebugRects;
+
+    state.particles.resize(particleEmitters.size());
+    for(size_t i = 0; i < particleEmitters.size(); i++) {
+        particleEmitters[i].buildVertices(state.particles[i]);
+    }
+
+    if(dialogSystem) {
+        dialogSystem->captureRenderState(state.dialog);
+    } else {
+        state.dialog.active = false;
     }
+
+    state.fadeAlpha = fadeAlpha;
+    state.previousFadeAlpha = previousFadeAlpha;
+    state.fadeRect = fadeRect;
+    state.valid = true;
 }
 
-void SceneManager::render() {
-    if(isPlayingVideo && videoPlayer->getTexture()) {
+void SceneManager::render(const RenderState& state, float alpha) {
+    SDL_Texture* videoTexture = state.showVideo ? videoPlayer->acquireTexture() : nullptr;
+
+    if(videoTexture) {
         // Сначала очищаем рендерер с прозрачным цветом (не синим)
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
         SDL_RenderClear(renderer);
         
         // Рендерим слои перед видео
-        for(const auto& layer : layers) {
+        for(const auto& layer : state.layers) {
             SDL_SetTextureAlphaMod(layer.texture, layer.opacity);
-            SDL_Rect dstRect = {0, 0, layer.width, layer.height};
-            int w, h;
-            SDL_GetRendererOutputSize(renderer, &w, &h);
-            dstRect.x = (w - layer.width) / 2;
-            dstRect.y = (h - layer.height) / 2;
-            SDL_RenderCopy(renderer, layer.texture, nullptr, &dstRect);
+            SDL_RenderCopy(renderer, layer.texture, nullptr, &layer.dstRect);
         }
         
-        // Рендерим видео с правильным режимом смешивания
-        SDL_SetTextureBlendMode(videoPlayer->getTexture(), SDL_BLENDMODE_BLEND);
-        SDL_RenderCopy(renderer, videoPlayer->getTexture(), nullptr, nullptr);
-    } else if(currentSceneType == SceneType::STATIC) {
+        // Рендерим видео (режим смешивания выставляется при создании текстуры)
+        SDL_RenderCopy(renderer, videoTexture, nullptr, nullptr);
+    } else if(state.staticScene) {
         SDL_SetRenderDrawColor(renderer, 
-            backgroundColor.r, 
-            backgroundColor.g, 
-            backgroundColor.b, 
-            backgroundColor.a);
+            state.backgroundColor.r, 
+            state.backgroundColor.g, 
+            state.backgroundColor.b, 
+            state.backgroundColor.a);
         SDL_RenderClear(renderer);
         
-        for(const auto& layer : layers) {
+        for(const auto& layer : state.layers) {
             SDL_SetTextureAlphaMod(layer.texture, layer.opacity);
-            SDL_Rect dstRect = {0, 0, layer.width, layer.height};
-            int w, h;
-            SDL_GetRendererOutputSize(renderer, &w, &h);
-            dstRect.x = (w - layer.width) / 2;
-            dstRect.y = (h - layer.height) / 2;
-            SDL_RenderCopy(renderer, layer.texture, nullptr, &dstRect);
+            SDL_RenderCopy(renderer, layer.texture, nullptr, &layer.dstRect);
         }
         
-        if(showGrid) {
-            drawGrid();
+        if(state.showGrid) {
+            drawGrid(state);
         }
         
-        player.render(renderer);
+        Player::render(renderer, state.player, alpha);
         
         // Рендерим коллизии (отладочное отображение)
         SDL_SetRenderDrawColor(renderer, 255, 0, 0, 128);
-        for(const auto& cell : collisionCells) {
-            SDL_Rect collisionRect = {
-                cell.second * GRID_SIZE,
-                cell.first * GRID_SIZE,
-                GRID_SIZE,
-                GRID_SIZE
-            };
-            SDL_RenderDrawRect(renderer, &collisionRect);
-        }
+        SDL_RenderDrawRects(renderer, state.collisionRects.data(), static_cast<int>(state.collisionRects.size()));
         
         // Отображаем точку коллизии игрока 
-        float playerCollisionX = player.getX() + player.getSize()/2;
-        float playerCollisionY = player.getY() + player.getSize() + player.getSize()/2 - 4;
+        const auto& playerState = state.player;
+        float playerX = playerState.previousX + (playerState.x - playerState.previousX) * alpha;
+        float playerY = playerState.previousY + (playerState.y - playerState.previousY) * alpha;
+        float playerCollisionX = playerX + playerState.size/2;
+        float playerCollisionY = playerY + playerState.size + playerState.size/2 - 4;
         SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
         SDL_Rect playerPoint = {
             static_cast<int>(playerCollisionX) - 2,
@@ -333,33 +489,26 @@ void SceneManager::render() {
         
         // Рендерим скрипт-клетки
         SDL_SetRenderDrawColor(renderer, 0, 0, 255, 128);
-        for(const auto& group : scriptCells) {
-            for(const auto& cell : group.cells) {
-                SDL_Rect scriptRect = {
-                    cell.second * GRID_SIZE,
-                    cell.first * GRID_SIZE,
-                    GRID_SIZE,
-                    GRID_SIZE
-                };
-                SDL_RenderDrawRect(renderer, &scriptRect);
-            }
+        SDL_RenderDrawRects(renderer, state.scriptCellRects.data(), static_cast<int>(state.scriptCellRects.size()));
+
+        for(const auto& vertices : state.particles) {
+            ParticleEmitter::renderBatch(renderer, vertices, particleIndices);
         }
     }
     
     if(dialogSystem) {
-        dialogSystem->render();
+        dialogSystem->render(state.dialog, alpha);
     }
     
-    renderFadeEffect();
+    renderFadeEffect(state, alpha);
 }
 
-void SceneManager::renderFadeEffect() {
-    if (fadeAlpha > 0.0f) {
+void SceneManager::renderFadeEffect(const RenderState& state, float alpha) {
+    float fade = state.previousFadeAlpha + (state.fadeAlpha - state.previousFadeAlpha) * alpha;
+    if (fade > 0.0f) {
         SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, static_cast<Uint8>(fadeAlpha * 255));
-        SDL_Rect fullscreen = {0, 0, 0, 0};
-        SDL_GetRendererOutputSize(renderer, &fullscreen.w, &fullscreen.h);
-        SDL_RenderFillRect(renderer, &fullscreen);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, static_cast<Uint8>(fade * 255));
+        SDL_RenderFillRect(renderer, &state.fadeRect);
         SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
     }
 }
@@ -386,34 +535,172 @@ void SceneManager::updatePlayerPosition() {
 }
 
 void SceneManager::loadCollisions(const json& sceneData) {
-    collisionCells.clear();
+    collisionGrid.clear();
+    collisionBindings.clear();
+    pathfinder.invalidateAll();
+    stopPlayerWalk();
+
+    if(sceneData.contains("collisionMask")) {
+        loadCollisionMask(sceneData["collisionMask"]);
+    }
     
-    if(sceneData.contains("collisions")) {
-        for(const auto& cell : sceneData["collisions"]) {
-            int row = cell["row"];
-            int col = cell["col"];
-            collisionCells.emplace_back(row, col);
-            std::cout << "Added collision at: [" << row << ", " << col << "]" << std::endl;
+    if(!sceneData.contains("collisions")) return;
+
+    // Сетка не меньше окна и вмещает все клетки сцены
+    int rows = outputHeight / GRID_SIZE;
+    int cols = outputWidth / GRID_SIZE;
+    for(const auto& cell : sceneData["collisions"]) {
+        rows = std::max(rows, cell["row"].get<int>() + 1);
+        cols = std::max(cols, cell["col"].get<int>() + 1);
+    }
+    collisionGrid.resize(rows, cols);
+
+    for(const auto& cell : sceneData["collisions"]) {
+        int row = cell["row"];
+        int col = cell["col"];
+        CollisionLayer layer = CollisionLayer::Solid;
+        std::string layerName = cell.value("layer", "solid");
+        if(!CollisionGrid::parseLayer(layerName, layer)) {
+            std::cout << "Unknown collision layer: " << layerName << std::endl;
+            continue;
+        }
+
+        if(cell.contains("var")) {
+            // Клетка привязана к условию над переменными, ее состояние выставит applyCollisionBindings
+            CollisionBinding binding{row, col, layer, ScriptExpression()};
+            std::string error;
+            if(!binding.condition.compile(cell["var"].get<std::string>(), error, globalVars)) {
+                std::cout << "Bad collision condition " << cell["var"] << ": " << error << std::endl;
+                continue;
+            }
+            collisionBindings.push_back(std::move(binding));
+        } else {
+            collisionGrid.set(row, col, layer, true);
         }
     }
+    bindingDependents.build(globalVars.size(), collisionBindings.size(),
+                            [this](size_t i) -> const std::vector<int>& { return collisionBindings[i].condition.getVariables(); });
+}
+
+void SceneManager::loadCollisionMask(const json& maskData) {
+    // Отдельная картинка-маска: твердые пиксели - непрозрачные
+    std::string imagePath = gamePath + "/image/" + maskData["image"].get<std::string>();
+    SDL_Surface* surface = IMG_Load(imagePath.c_str());
+    if(!surface) {
+        std::cout << "Failed to load collision mask: " << IMG_GetError() << std::endl;
+        return;
+    }
+    if(!collisionMask.empty()) {
+        std::cout << "Collision mask from layer replaced by: " << imagePath << std::endl;
+    }
+    collisionMask.build(surface, static_cast<Uint8>(maskData.value("alphaThreshold", 128)));
+    SDL_FreeSurface(surface);
+    updateLayerPlacement();
+}
+
+void SceneManager::applyCollisionBindings(int slot) {
+    auto apply = [this](const CollisionBinding& binding) {
+        setCollisionCell(binding.row, binding.col, binding.layer, binding.condition.evaluateCondition(globalVars));
+    };
+    if(slot < 0) {
+        for(const auto& binding : collisionBindings) apply(binding);
+        return;
+    }
+    bindingDependents.forEach(slot, [&](int index) { apply(collisionBindings[index]); });
+}
+
+void SceneManager::notifyVariableChanged(int slot) {
+    applyCollisionBindings(slot);
+    watcherDependents.forEach(slot, [this](int index) { checkWatcher(watchers[index]); });
+}
+
+void SceneManager::loadWatchers(const json& sceneData) {
+    watchers.clear();
+    watcherDependents.clear();
+    watchersPending = false;
+    if(!sceneData.contains("Watchers")) return;
+
+    for(const auto& entry : sceneData["Watchers"]) {
+        VariableWatcher watcher;
+        std::string error;
+        if(!watcher.condition.compile(entry["condition"].get<std::string>(), error, globalVars)) {
+            std::cout << "Bad watcher condition " << entry["condition"] << ": " << error << std::endl;
+            continue;
+        }
+        watcher.scriptGroupName = entry.value("script", "");
+        watcher.once = entry.value("once", false);
+        watchers.push_back(std::move(watcher));
+    }
+    watcherDependents.build(globalVars.size(), watchers.size(),
+                            [this](size_t i) -> const std::vector<int>& { return watchers[i].condition.getVariables(); });
+}
+
+void SceneManager::checkWatcher(VariableWatcher& watcher) {
+    if(watcher.done) return;
+    const bool value = watcher.condition.evaluateCondition(globalVars);
+    if(value && !watcher.value) {
+        if(watcher.script >= 0 && !executeScriptGroup(watcher.script)) {
+            // Группа еще выполняется - переход не теряем, запустим ее после завершения
+            watcher.pending = true;
+            watchersPending = true;
+        } else {
+            markWatcherFired(watcher);
+        }
+    }
+    watcher.value = value;
+}
+
+void SceneManager::markWatcherFired(VariableWatcher& watcher) {
+    if(!watcher.once) return;
+    watcher.done = true;
+    if(journal.isEnabled()) {
+        const size_t start = beginJournalRecord(JournalRecord::Watcher);
+        journalPut(journalRecords, static_cast<uint32_t>(&watcher - watchers.data()));
+        endJournalRecord(start);
+    }
+}
+
+void SceneManager::retryPendingWatchers() {
+    if(!watchersPending) return;
+    watchersPending = false;
+    for(auto& watcher : watchers) {
+        if(!watcher.pending) continue;
+        // После перезагрузки ScriptGroups группы может уже не быть
+        if(watcher.script >= 0 && scripts.isRunning(scriptGroups[watcher.script].program)) {
+            watchersPending = true;
+            continue;
+        }
+        // Условие могло снова стать ложным, пока группа выполнялась
+        watcher.pending = false;
+        if(watcher.script < 0 || watcher.done || !watcher.condition.evaluateCondition(globalVars)) continue;
+        executeScriptGroup(watcher.script);
+        markWatcherFired(watcher);
+    }
+}
+
+void SceneManager::setCollisionCell(int row, int col, CollisionLayer layer, bool value) {
+    collisionGrid.set(row, col, layer, value);
+    pathfinder.onCellChanged(row, col);
+}
+
+void SceneManager::rebuildCollisionDebugRects() {
+    collisionDebugRects.clear();
+    collisionGrid.forEachSet(CollisionLayer::Solid, [this](int row, int col) {
+        collisionDebugRects.push_back({col * GRID_SIZE, row * GRID_SIZE, GRID_SIZE, GRID_SIZE});
+    });
+    collisionDebugVersion = collisionGrid.getVersion();
 }
 
 void SceneManager::loadScriptGroups(const json& sceneData) {
+    scripts.clear();  // Программы пересоздаются, старые скрипты на них больше не ссылаются
     scriptGroups.clear();
     
     if(sceneData.contains("ScriptGroups")) {
         for(const auto& groupData : sceneData["ScriptGroups"]) {
             ScriptGroup group;
             group.name = groupData["name"];
-            
-            for(const auto& cmdData : groupData["script"]) {
-                for(auto it = cmdData.begin(); it != cmdData.end(); ++it) {
-                    ScriptCommand cmd;
-                    cmd.command = it.key();
-                    cmd.parameter = it.value();
-                    group.commands.push_back(cmd);
-                }
-            }
+            // Компилируем один раз, дальше выполняется только байткод
+            ScriptCompiler::compile(groupData["script"], group.name, group.program, globalVars);
             
             scriptGroups.push_back(group);
         }
@@ -427,7 +714,17 @@ void SceneManager::loadScriptCells(const json& sceneData) {
         for(const auto& group : sceneData["ScriptCells"]) {
             ScriptCellGroup cellGroup;
             cellGroup.needUseKey = group.value("needUseKey", true);
-            cellGroup.scriptGroupName = group["scriptGroup"];
+            cellGroup.scriptGroupName = group.value("scriptGroup", "");
+            cellGroup.onEnter = group.value("onEnter", "");
+            cellGroup.onExit = group.value("onExit", "");
+            cellGroup.onStay = group.value("onStay", "");
+            cellGroup.cooldown = group.value("cooldown", 0.0f);
+            // Старый формат: группа без клавиши срабатывала, пока игрок стоит в клетке.
+            // Теперь она срабатывает один раз при входе.
+            if(!cellGroup.needUseKey && cellGroup.onEnter.empty()) {
+                cellGroup.onEnter = cellGroup.scriptGroupName;
+                cellGroup.scriptGroupName.clear();
+            }
             
             for(const auto& cell : group["cells"]) {
                 int row = cell["row"];
@@ -437,6 +734,54 @@ void SceneManager::loadScriptCells(const json& sceneData) {
             scriptCells.push_back(cellGroup);
         }
     }
+    buildTriggerIndex();
+}
+
+void SceneManager::buildTriggerIndex() {
+    triggerRows = 0;
+    triggerCols = 0;
+    scriptCellDebugRects.clear();
+    for(const auto& group : scriptCells) {
+        for(const auto& cell : group.cells) {
+            triggerRows = std::max(triggerRows, cell.first + 1);
+            triggerCols = std::max(triggerCols, cell.second + 1);
+            scriptCellDebugRects.push_back({cell.second * GRID_SIZE, cell.first * GRID_SIZE, GRID_SIZE, GRID_SIZE});
+        }
+    }
+
+    // Считаем группы на клетку, затем раскладываем их подряд (одна группа - одна запись на клетку)
+    const size_t cellCount = static_cast<size_t>(triggerRows) * triggerCols;
+    triggerCellStart.assign(cellCount + 1, 0);
+    std::vector<int> lastGroup(cellCount, -1);
+    for(size_t g = 0; g < scriptCells.size(); g++) {
+        for(const auto& cell : scriptCells[g].cells) {
+            if(cell.first < 0 || cell.second < 0) continue;
+            const int index = cell.first * triggerCols + cell.second;
+            if(lastGroup[index] == static_cast<int>(g)) continue;
+            lastGroup[index] = static_cast<int>(g);
+            triggerCellStart[index + 1]++;
+        }
+    }
+    for(size_t i = 0; i < cellCount; i++) {
+        triggerCellStart[i + 1] += triggerCellStart[i];
+    }
+
+    triggerCellGroups.assign(triggerCellStart[cellCount], 0);
+    std::vector<int> fill(triggerCellStart.begin(), triggerCellStart.end() - 1);
+    std::fill(lastGroup.begin(), lastGroup.end(), -1);
+    for(size_t g = 0; g < scriptCells.size(); g++) {
+        for(const auto& cell : scriptCells[g].cells) {
+            if(cell.first < 0 || cell.second < 0) continue;
+            const int index = cell.first * triggerCols + cell.second;
+            if(lastGroup[index] == static_cast<int>(g)) continue;
+            lastGroup[index] = static_cast<int>(g);
+            triggerCellGroups[fill[index]++] = static_cast<int>(g);
+        }
+    }
+
+    occupiedRow = occupiedLeftCol = occupiedRightCol = -1;
+    occupiedTriggerGroups.clear();
+    sceneTime = 0.0;
 }
 
 void SceneManager::loadDialogGroups(const json& sceneData) {
@@ -453,13 +798,166 @@ void SceneManager::loadDialogGroups(const json& sceneData) {
                 line.text = lineData["text"];
                 line.avatar = lineData.value("avatar", "none");
                 line.animDuration = lineData.value("animDuration", 1.0f); // Добавляем загрузку времени анимации
-                line.displayedText = "";
                 group.lines.push_back(line);
             }
             
             dialogGroups.push_back(group);
         }
     }
+    if(dialogSystem) dialogSystem->preloadAvatars(dialogGroups);
+}
+
+void SceneManager::loadParticles(const json& sceneData) {
+    particleEmitters.clear();
+
+    if(!sceneData.contains("particles")) return;
+
+    for(const auto& data : sceneData["particles"]) {
+        ParticleEmitterConfig config;
+        config.name = data["name"];
+        config.capacity = data.value("capacity", 1024);
+        config.rate = data.value("rate", 100.0f);
+        config.size = data.value("size", 2.0f);
+        config.fade = data.value("fade", true);
+        config.active = data.value("active", true);
+        config.seed = data.value("seed", 1u) ^ randomSeed;
+
+        if(data.contains("area")) {
+            const auto& area = data["area"];
+            config.area = {area.value("x", 0.0f), area.value("y", 0.0f),
+                           area.value("w", 0.0f), area.value("h", 0.0f)};
+        } else {
+            // По умолчанию частицы появляются вдоль верхнего края окна
+            config.followViewport = true;
+            config.area = {0.0f, 0.0f, static_cast<float>(outputWidth), 0.0f};
+        }
+        if(data.contains("velocity")) {
+            const auto& vel = data["velocity"];
+            config.minVelX = vel.value("minX", 0.0f);
+            config.maxVelX = vel.value("maxX", 0.0f);
+            config.minVelY = vel.value("minY", 0.0f);
+            config.maxVelY = vel.value("maxY", 0.0f);
+        }
+        if(data.contains("gravity")) {
+            config.gravityX = data["gravity"].value("x", 0.0f);
+            config.gravityY = data["gravity"].value("y", 0.0f);
+        }
+        if(data.contains("life")) {
+            config.minLife = data["life"].value("min", 1.0f);
+            config.maxLife = data["life"].value("max", config.minLife);
+        }
+        if(data.contains("color")) {
+            const auto& color = data["color"];
+            config.color.r = color.value("r", 255);
+            config.color.g = color.value("g", 255);
+            config.color.b = color.value("b", 255);
+            config.color.a = color.value("a", 255);
+        }
+
+        particleEmitters.emplace_back(config);
+    }
+}
+
+int SceneManager::findEmitter(const std::string& name) const {
+    for(size_t i = 0; i < particleEmitters.size(); i++) {
+        if(particleEmitters[i].getName() == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+int SceneManager::findScriptGroup(const std::string& name) const {
+    for(size_t i = 0; i < scriptGroups.size(); i++) {
+        if(scriptGroups[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+int SceneManager::findDialogGroup(const std::string& name) const {
+    for(size_t i = 0; i < dialogGroups.size(); i++) {
+        if(dialogGroups[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void SceneManager::linkScene() {
+    int dangling = 0;
+    auto linkScript = [&](const std::string& name, const char* event, int cellGroup) {
+        if(name.empty()) return -1;
+        int index = findScriptGroup(name);
+        if(index < 0) {
+            std::cout << "Link: ScriptCells[" << cellGroup << "]." << event << ": unknown script group " << name << std::endl;
+            dangling++;
+        }
+        return index;
+    };
+    for(size_t i = 0; i < scriptCells.size(); i++) {
+        auto& cell = scriptCells[i];
+        const int id = static_cast<int>(i);
+        cell.useScript = linkScript(cell.scriptGroupName, "scriptGroup", id);
+        cell.enterScript = linkScript(cell.onEnter, "onEnter", id);
+        cell.exitScript = linkScript(cell.onExit, "onExit", id);
+        cell.stayScript = linkScript(cell.onStay, "onStay", id);
+    }
+    for(size_t i = 0; i < watchers.size(); i++) {
+        auto& watcher = watchers[i];
+        watcher.script = findScriptGroup(watcher.scriptGroupName);
+        if(watcher.script < 0) {
+            std::cout << "Link: Watchers[" << i << "].script: unknown script group " << watcher.scriptGroupName << std::endl;
+            dangling++;
+        }
+    }
+
+    for(auto& group : scriptGroups) {
+        dangling += linkProgram(group.program);
+    }
+    dangling += linkProgram(initialScript);
+
+    for(const auto& group : dialogGroups) {
+        for(const auto& line : group.lines) {
+            if(line.avatar == "none") continue;
+            if(!std::ifstream(gamePath + "/image/" + line.avatar).good()) {
+                std::cout << "Link: dialog " << group.name << ": missing avatar " << line.avatar << std::endl;
+                dangling++;
+            }
+        }
+    }
+
+    if(dangling > 0) {
+        std::cout << "Link: " << dangling << " dangling reference(s) in scene " << currentSceneName << std::endl;
+    }
+}
+
+int SceneManager::linkProgram(ScriptProgram& program) {
+    int dangling = 0;
+    auto report = [&](const std::string& what) {
+        std::cout << "Link: script " << program.name << ": " << what << std::endl;
+        dangling++;
+    };
+    for(auto& ins : program.code) {
+        // Имена с {переменными} известны только при выполнении - их ищем тогда
+        const bool dynamic = ins.flag & SCRIPT_FLAG_INTERPOLATE;
+        switch(ins.op) {
+        case ScriptOp::ShowDialog:
+            ins.b = -1;
+            if(dynamic) break;
+            ins.b = findDialogGroup(program.string(ins.arg));
+            if(ins.b < 0) report("unknown dialog group " + program.string(ins.arg));
+            break;
+        case ScriptOp::ShowVideo:
+            if(!dynamic && !std::ifstream(gamePath + "/video/" + program.string(ins.arg)).good()) {
+                report("missing video " + program.string(ins.arg));
+            }
+            break;
+        case ScriptOp::Particles:
+        case ScriptOp::ParticleBurst:
+            ins.b = findEmitter(program.string(ins.arg));
+            if(ins.b < 0) report("unknown particle emitter " + program.string(ins.arg));
+            break;
+        default:
+            break;
+        }
+    }
+    return dangling;
 }
 
 bool SceneManager::isCollision(float x, float y) const {
@@ -472,10 +970,59 @@ bool SceneManager::isCollision(float x, float y) const {
         return true; // Считаем выход за пределы карты коллизией
     }
     
-    // std::cout << "Checking collision at grid: [" << row << ", " << col << "]" << std::endl;
-    
-    return std::find(collisionCells.begin(), collisionCells.end(), 
-                    std::make_pair(row, col)) != collisionCells.end();
+    if(collisionGrid.testAny(row, col, PLAYER_BLOCKING_LAYERS)) {
+        return true;
+    }
+    return collisionMask.test(static_cast<int>(std::floor(x)) - collisionMaskX,
+                              static_cast<int>(std::floor(y)) - collisionMaskY);
+}
+
+float SceneManager::sweepX(const SDL_FRect& box, float dx) const {
+    const float lead = dx > 0.0f ? box.x + box.w : box.x;
+
+    // Клетки сетки: за пределами окна все занято, как и в isCollision
+    int rowFirst, rowLast;
+    cellSpan(box.y, box.h, GRID_SIZE, rowFirst, rowLast);
+    float t = sweepCells(lead, dx, GRID_SIZE, [&](int col) {
+        if(col < 0 || col >= gridCols) return true;
+        for(int row = rowFirst; row <= rowLast; row++) {
+            if(row < 0 || row >= gridRows || collisionGrid.testAny(row, col, PLAYER_BLOCKING_LAYERS)) return true;
+        }
+        return false;
+    });
+
+    // Попиксельная маска: клетка - один пиксель, проверяем только отрезок до касания с сеткой
+    if(!collisionMask.empty()) {
+        int pixelFirst, pixelLast;
+        cellSpan(box.y - collisionMaskY, box.h, 1.0f, pixelFirst, pixelLast);
+        t *= sweepCells(lead - collisionMaskX, dx * t, 1.0f, [&](int px) {
+            return collisionMask.testColumn(px, pixelFirst, pixelLast);
+        });
+    }
+    return t;
+}
+
+float SceneManager::sweepY(const SDL_FRect& box, float dy) const {
+    const float lead = dy > 0.0f ? box.y + box.h : box.y;
+
+    int colFirst, colLast;
+    cellSpan(box.x, box.w, GRID_SIZE, colFirst, colLast);
+    float t = sweepCells(lead, dy, GRID_SIZE, [&](int row) {
+        if(row < 0 || row >= gridRows) return true;
+        for(int col = colFirst; col <= colLast; col++) {
+            if(col < 0 || col >= gridCols || collisionGrid.testAny(row, col, PLAYER_BLOCKING_LAYERS)) return true;
+        }
+        return false;
+    });
+
+    if(!collisionMask.empty()) {
+        int pixelFirst, pixelLast;
+        cellSpan(box.x - collisionMaskX, box.w, 1.0f, pixelFirst, pixelLast);
+        t *= sweepCells(lead - collisionMaskY, dy * t, 1.0f, [&](int py) {
+            return collisionMask.testRow(py, pixelFirst, pixelLast);
+        });
+    }
+    return t;
 }
 
 std::pair<int, int> SceneManager::getCurrentPlayerCell() const {
@@ -490,208 +1037,255 @@ std::pair<int, int> SceneManager::getCurrentPlayerCell() const {
     return {row, col};
 }
 
-void SceneManager::checkPlayerInScriptCells() const {
+void SceneManager::getPlayerFeetCells(int& row, int& leftCol, int& rightCol) const {
     float playerLeft = player.getX() + player.getSize()/4;
     float playerRight = player.getX() + player.getSize()*3/4;
     float playerY = player.getY() + player.getSize() + player.getSize()/2 - 4;
     
-    int playerRow = static_cast<int>(std::floor(playerY / GRID_SIZE));
-    int leftCol = static_cast<int>(std::floor(playerLeft / GRID_SIZE));
-    int rightCol = static_cast<int>(std::floor(playerRight / GRID_SIZE));
-    
-    for(size_t i = 0; i < scriptCells.size(); i++) {
-        const auto& group = scriptCells[i];
-        for(const auto& cell : group.cells) {
-            if(cell.first == playerRow && 
-               (cell.second == leftCol || cell.second == rightCol)) {
-                if(!group.needUseKey) {
-                    const_cast<SceneManager*>(this)->executeScriptGroup(group.scriptGroupName);
-                }
+    row = static_cast<int>(std::floor(playerY / GRID_SIZE));
+    leftCol = static_cast<int>(std::floor(playerLeft / GRID_SIZE));
+    rightCol = static_cast<int>(std::floor(playerRight / GRID_SIZE));
+}
+
+void SceneManager::collectTriggerGroups(int row, int leftCol, int rightCol, std::vector<int>& groups) const {
+    groups.clear();
+    if(row < 0 || row >= triggerRows) return;
+    for(int col = std::max(leftCol, 0); col <= std::min(rightCol, triggerCols - 1); col++) {
+        const int index = row * triggerCols + col;
+        for(int i = triggerCellStart[index]; i < triggerCellStart[index + 1]; i++) {
+            // Ноги занимают не больше двух клеток, поэтому линейная проверка дубликатов дешевле set
+            if(std::find(groups.begin(), groups.end(), triggerCellGroups[i]) == groups.end()) {
+                groups.push_back(triggerCellGroups[i]);
             }
         }
     }
 }
 
-void SceneManager::useCurrentCell() {
-    if(currentSceneType != SceneType::STATIC) return;
-    
-    float playerLeft = player.getX() + player.getSize()/4;
-    float playerRight = player.getX() + player.getSize()*3/4;
-    float playerY = player.getY() + player.getSize() + player.getSize()/2 - 4;
-    
-    int playerRow = static_cast<int>(std::floor(playerY / GRID_SIZE));
-    int leftCol = static_cast<int>(std::floor(playerLeft / GRID_SIZE));
-    int rightCol = static_cast<int>(std::floor(playerRight / GRID_SIZE));
-    
-    for(size_t i = 0; i < scriptCells.size(); i++) {
-        const auto& group = scriptCells[i];
-        if(group.needUseKey) {
-            for(const auto& cell : group.cells) {
-                if(cell.first == playerRow && 
-                   (cell.second == leftCol || cell.second == rightCol)) {
-                    executeScriptGroup(group.scriptGroupName);
-                }
+bool SceneManager::fireTrigger(ScriptCellGroup& group, int scriptGroup) {
+    if(sceneTime < group.readyTime) return false;
+    if(!executeScriptGroup(scriptGroup)) return false;
+    group.readyTime = sceneTime + group.cooldown;
+    return true;
+}
+
+void SceneManager::updateScriptTriggers() {
+    int row, leftCol, rightCol;
+    getPlayerFeetCells(row, leftCol, rightCol);
+
+    // Набор групп пересчитывается только при смене клеток под ногами
+    if(row != occupiedRow || leftCol != occupiedLeftCol || rightCol != occupiedRightCol) {
+        occupiedRow = row;
+        occupiedLeftCol = leftCol;
+        occupiedRightCol = rightCol;
+        collectTriggerGroups(row, leftCol, rightCol, nextTriggerGroups);
+
+        for(int index : occupiedTriggerGroups) {
+            if(std::find(nextTriggerGroups.begin(), nextTriggerGroups.end(), index) != nextTriggerGroups.end()) continue;
+            ScriptCellGroup& group = scriptCells[index];
+            // Выход срабатывает, только если сработал вход, и не ждет кулдауна
+            if(group.entered && group.exitScript >= 0) {
+                executeScriptGroup(group.exitScript);
             }
+            group.entered = false;
         }
+        occupiedTriggerGroups.swap(nextTriggerGroups);
     }
-}
 
-void SceneManager::executeScriptGroup(const std::string& groupName) {
-    if (isExecutingScript) return;  // Блокируем запуск если скрипт уже выполняется
-    
-    activeCommands.clear();
-    isExecutingScript = true;
-    
-    for(const auto& group : scriptGroups) {
-        if(group.name == groupName) {
-            processScriptCommands(group.commands);
-            break;
+    // Вход, не сработавший из-за кулдауна или идущего скрипта, повторяем, пока игрок в клетке
+    for(int index : occupiedTriggerGroups) {
+        ScriptCellGroup& group = scriptCells[index];
+        if(!group.entered) {
+            group.entered = group.enterScript < 0 || fireTrigger(group, group.enterScript);
+        } else if(group.stayScript >= 0) {
+            fireTrigger(group, group.stayScript);
         }
     }
 }
 
-void SceneManager::processScriptCommands(const std::vector<ScriptCommand>& commands) {
-    for(const auto& cmd : commands) {
-        if(cmd.command == "if") {
-            // Новый формат с вложенными then/else блоками
-            if(cmd.parameter.contains("condition")) {
-                bool result = evaluateCondition(cmd.parameter["condition"]);
-                if(result && cmd.parameter.contains("then")) {
-                    for(const auto& thenCmd : cmd.parameter["then"]) {
-                        processCommand(thenCmd);
-                    }
-                }
-                else if(!result && cmd.parameter.contains("else")) {
-                    for(const auto& elseCmd : cmd.parameter["else"]) {
-                        processCommand(elseCmd);
-                    }
-                }
-            }
-        } else {
-            processCommand(json{{cmd.command, cmd.parameter}});
+void SceneManager::useCurrentCell() {
+    if(currentSceneType != SceneType::STATIC) return;
+    
+    int row, leftCol, rightCol;
+    getPlayerFeetCells(row, leftCol, rightCol);
+    collectTriggerGroups(row, leftCol, rightCol, nextTriggerGroups);
+    for(int index : nextTriggerGroups) {
+        const auto& group = scriptCells[index];
+        if(group.needUseKey && group.useScript >= 0) {
+            executeScriptGroup(group.useScript);
         }
     }
 }
 
-void SceneManager::processCommand(const json& cmd) {
-    for(auto it = cmd.begin(); it != cmd.end(); ++it) {
-        if(it.key() == "if") {
-            // Рекурсивно обрабатываем вложенные if
-            ScriptCommand ifCmd;
-            ifCmd.command = "if";
-            ifCmd.parameter = it.value();
-            processScriptCommands({ifCmd});
-        } else {
-            ScriptCommand processedCmd;
-            processedCmd.command = it.key();
-            processedCmd.parameter = it.value();
-            if(processedCmd.parameter.is_string()) {
-                std::string parsedParam = parseVarString(processedCmd.parameter.get<std::string>());
-                processedCmd.parameter = parsedParam;
-            }
-            activeCommands.push_back(processedCmd);
-        }
-    }
+bool SceneManager::executeScriptGroup(int index) {
+    const ScriptProgram& program = scriptGroups[index].program;
+    // Разные группы выполняются параллельно, одна и та же - не больше одного экземпляра
+    if(scripts.isRunning(program)) return false;
+    scripts.start(program);
+    return true;
 }
 
-void SceneManager::updateActiveCommands(float deltaTime) {
-    if (activeCommands.empty()) {
-        isExecutingScript = false;  // Сбрасываем флаг когда все команды выполнены
-        return;
-    }
+const std::string& SceneManager::scriptString(const ScriptProgram& program, uint16_t index, uint8_t flag) {
+    if(!(flag & SCRIPT_FLAG_INTERPOLATE)) return program.string(index);
+    program.templates[index].format(globalVars, scriptText);
+    return scriptText;
+}
 
-    auto& currentCommand = activeCommands.front();
-    
-    if (!currentCommand.isStarted) {
-        startCommand(currentCommand);
-        currentCommand.isStarted = true;
-    }
-    
-    if (currentCommand.command == "fadeIn" || currentCommand.command == "fadeOut") {
-        if (!updateFade(deltaTime)) {
-            currentCommand.isComplete = true;
-        }
-    } else if (currentCommand.command == "wait") {
-        currentCommand.time_left -= deltaTime;
-        if (currentCommand.time_left <= 0) {
-            currentCommand.isComplete = true;
+ScriptEvent SceneManager::executeInstruction(const ScriptProgram& program, const ScriptInstruction& ins) {
+    switch(ins.op) {
+    case ScriptOp::ShowDialog:
+        if(ins.flag & SCRIPT_FLAG_INTERPOLATE) {
+            toggleDialog(scriptString(program, ins.arg, ins.flag));
+        } else {
+            openDialog(ins.b);
         }
-    }
-    
-    if (isCommandComplete(currentCommand)) {
-        activeCommands.erase(activeCommands.begin());
-    }
-}
-
-void SceneManager::startCommand(ScriptCommand& command) {
-    if (command.command == "showDialog") {
-        toggleDialog(command.parameter);
-    } else if (command.command == "showDebugMessage") {
-        std::cout << "Debug: " << command.parameter << std::endl;
-        command.isComplete = true;
-    } else if (command.command == "wait") {
-        command.time_left = static_cast<float>(command.parameter.get<double>());
-    } else if (command.command == "playerMovement") {
-        player.setMovementEnabled(command.parameter.get<bool>());
-        command.isComplete = true;
-    } else if (command.command == "fadeIn") {
-        float duration = static_cast<float>(command.parameter.get<double>());
+        // Диалог не найден - ждать нечего
+        return dialogSystem->isActive() ? ScriptEvent::DialogClosed : ScriptEvent::None;
+    case ScriptOp::DebugMessage:
+        std::cout << "Debug: " << scriptString(program, ins.arg, ins.flag) << std::endl;
+        return ScriptEvent::None;
+    case ScriptOp::PlayerMovement:
+        player.setMovementEnabled(ins.flag & SCRIPT_FLAG_BOOL);
+        return ScriptEvent::None;
+    case ScriptOp::FadeIn:
         fadeTarget = 0.0f;
-        fadeAlpha = 1.0f;
-        fadeSpeed = -1.0f / duration;
+        fadeAlpha = previousFadeAlpha = 1.0f;
+        fadeSpeed = -1.0f / ins.value;
         isFading = true;
-    } else if (command.command == "fadeOut") {
-        float duration = static_cast<float>(command.parameter.get<double>());
+        return ScriptEvent::FadeEnd;
+    case ScriptOp::FadeOut:
         fadeTarget = 1.0f;
-        fadeAlpha = 0.0f;
-        fadeSpeed = 1.0f / duration;
+        fadeAlpha = previousFadeAlpha = 0.0f;
+        fadeSpeed = 1.0f / ins.value;
         isFading = true;
-    } else if (command.command == "setVar") {
-        const auto& params = command.parameter;
-        if(params.is_array() && params.size() == 2) {
-            std::string varName = params[0];
-            std::string expression = params[1];
-            globalVars[varName] = evaluateExpression(expression);
+        return ScriptEvent::FadeEnd;
+    case ScriptOp::SetVar: {
+        const uint16_t operand = static_cast<uint16_t>(ins.b);
+        if(journal.isEnabled()) {
+            journalVariable(ins.a);
         }
-        command.isComplete = true;
-    } else if (command.command == "showVid") {
-        std::string videoPath = command.parameter.get<std::string>();
-        if (!initializeVideo(videoPath)) {
-            command.isComplete = true;
+        if(ins.flag & SCRIPT_FLAG_TEXT) {
+            globalVars.setString(ins.a, scriptString(program, operand, ins.flag));
+        } else {
+            program.expressions[operand].assignTo(globalVars, ins.a);
         }
+        notifyVariableChanged(ins.a);
+        return ScriptEvent::None;
+    }
+    case ScriptOp::SetCollision:
+        setCollisionCell(ins.a, ins.b, static_cast<CollisionLayer>(ins.arg), ins.flag & SCRIPT_FLAG_BOOL);
+        return ScriptEvent::None;
+    case ScriptOp::WalkTo:
+        // Игрок идет в клетку в обход препятствий
+        if(!startPlayerWalk({ins.a, ins.b})) {
+            std::cout << "walkTo: no path to " << ins.a << ", " << ins.b << std::endl;
+            return ScriptEvent::None;
+        }
+        return ScriptEvent::WalkEnd;
+    case ScriptOp::ShowVideo:
+        if(!initializeVideo(scriptString(program, ins.arg, ins.flag))) return ScriptEvent::None;
+        // Видео не откатывается: скрипт, ждущий его конца, не должен вернуться в журнал
+        journalResetPending = true;
+        return ScriptEvent::VideoEnd;
+    case ScriptOp::Particles:
+        if(ins.b >= 0) {
+            particleEmitters[ins.b].setActive(ins.flag & SCRIPT_FLAG_BOOL);
+        }
+        return ScriptEvent::None;
+    case ScriptOp::ParticleBurst:
+        if(ins.b >= 0) {
+            particleEmitters[ins.b].burst(ins.a);
+        }
+        return ScriptEvent::None;
+    default:
+        return ScriptEvent::None;
     }
 }
 
-bool SceneManager::isCommandComplete(const ScriptCommand& command) const {
-    if (command.command == "showDialog") {
-        return !dialogSystem->isActive();
-    } else if (command.command == "showDebugMessage" || command.command == "playerMovement") {
-        return command.isComplete;
-    } else if (command.command == "wait") {
-        return command.isComplete;
-    } else if (command.command == "fadeIn" || command.command == "fadeOut") {
-        return command.isComplete && !isFading;  // Добавляем проверку isFading
-    } else if (command.command == "showVid") {
-        return command.isComplete || !isPlayingVideo;
+bool SceneManager::startPlayerWalk(std::pair<int, int> goal) {
+    std::pair<int, int> start = getCurrentPlayerCell();
+    if(!pathfinder.findPath(start, goal, playerPath)) {
+        stopPlayerWalk();
+        return false;
     }
+    // Сначала выходим в центр текущей клетки, чтобы не задевать углы соседних
+    playerPath.insert(playerPath.begin(), start);
+    playerPathIndex = 0;
+    playerPathVersion = collisionGrid.getVersion();
+    playerStuckTime = 0.0f;
+    player.setAutopilot(true);
     return true;
 }
 
-void SceneManager::executeCommand(const ScriptCommand& command) {
-    // Этот метод теперь только добавляет команды в очередь
-    activeCommands.push_back(command);
+void SceneManager::stopPlayerWalk() {
+    playerPath.clear();
+    playerPathIndex = 0;
+    player.setAutopilot(false);
+    player.setVelocity(0, 0);
+    scripts.signal(ScriptEvent::WalkEnd);
 }
 
-void SceneManager::toggleDialog(const std::string& dialogName) {
-    if(!dialogSystem->isActive()) {
-        for(const auto& group : dialogGroups) {
-            if(group.name == dialogName) {
-                dialogSystem->setCurrentGroup(&group);
-                dialogSystem->showDialog(dialogName);
-                break;
-            }
+void SceneManager::updatePlayerWalk(float deltaTime) {
+    // Коллизии изменились по ходу движения - перестраиваем путь от текущей клетки
+    if(collisionGrid.getVersion() != playerPathVersion) {
+        std::pair<int, int> goal = playerPath.back();
+        if(!startPlayerWalk(goal)) {
+            std::cout << "walkTo: path blocked" << std::endl;
+            return;
         }
     }
+
+    // Точка, по которой игрок проверяет коллизии, - ее и ведем по центрам клеток
+    const float size = static_cast<float>(player.getSize());
+    const float pointX = player.getX() + size / 2;
+    const float pointY = player.getY() + size + size / 2 - 4;
+    const float step = player.getSpeed() * deltaTime;
+
+    float dx = 0.0f, dy = 0.0f, distance = 0.0f;
+    while(playerPathIndex < playerPath.size()) {
+        const auto& cell = playerPath[playerPathIndex];
+        dx = cell.second * GRID_SIZE + GRID_SIZE / 2 - pointX;
+        dy = cell.first * GRID_SIZE + GRID_SIZE / 2 - pointY;
+        distance = std::sqrt(dx * dx + dy * dy);
+        if(distance > 0.5f) break;
+        playerPathIndex++;
+    }
+
+    if(playerPathIndex >= playerPath.size() || step <= 0.0f) {
+        stopPlayerWalk();
+        return;
+    }
+
+    // Скорость не больше обычной, последний шаг ровно до центра клетки
+    float scale = 1.0f / std::max(distance, step);
+    player.setVelocity(dx * scale, dy * scale);
+
+    // Если что-то не дает пройти (например, маска коллизий), не висим в скрипте вечно
+    if(player.getX() == player.getPreviousX() && player.getY() == player.getPreviousY()) {
+        playerStuckTime += deltaTime;
+        if(playerStuckTime > 1.0f) {
+            std::cout << "walkTo: player is stuck" << std::endl;
+            stopPlayerWalk();
+        }
+    } else {
+        playerStuckTime = 0.0f;
+    }
+}
+
+void SceneManager::toggleDialog(const std::string& dialogName) {
+    // По имени - только отладочная клавиша и имена с {переменными}
+    int index = findDialogGroup(dialogName);
+    if(index < 0) {
+        std::cout << "Dialog group not found: " << dialogName << std::endl;
+        return;
+    }
+    openDialog(index);
+}
+
+void SceneManager::openDialog(int index) {
+    if(index < 0 || dialogSystem->isActive()) return;
+    const DialogGroup& group = dialogGroups[index];
+    dialogSystem->setCurrentGroup(&group);
+    dialogSystem->showDialog(group.name);
 }
 
 void SceneManager::handleUseKey() {
@@ -715,7 +1309,7 @@ void SceneManager::initializePlayer(const json& sceneData) {
     
     std::string playerSkin = playerData.value("skin", "marko");
     std::string spritePath = gamePath + "/skin/" + playerSkin + "/spritesheet.png";
-    if (!player.loadSprite(renderer, spritePath)) {
+    if (!player.loadSprite(assets, spritePath)) {
         std::cout << "Failed to load player skin: " << playerSkin << std::endl;
     }
     
@@ -723,303 +1317,388 @@ void SceneManager::initializePlayer(const json& sceneData) {
 }
 
 void SceneManager::updatePlayerVelocity(float dx, float dy) {
+    // Пока игрок идет по пути, ввод игнорируется
+    if(!playerPath.empty()) return;
     player.setVelocity(dx, dy);
 }
 
 void SceneManager::loadGlobalVars(const json& sceneData) {
     if (!sceneData.contains("GlobalVars")) return;
-    
-    const auto& vars = sceneData["GlobalVars"];
-    for (auto it = vars.begin(); it != vars.end(); ++it) {
-        globalVars[it.key()] = parseJsonValue(it.value());
-    }
+    globalVars.loadJson(sceneData["GlobalVars"]);
 }
 
-bool SceneManager::evaluateCondition(const std::string& condition) {
-    std::string parsedCondition = parseVarString(condition);
-    
-    // Split by 'and' or 'or'
-    std::vector<std::string> parts;
-    size_t pos = 0;
-    std::string currentPart;
-    
-    while (pos < parsedCondition.length()) {
-        if (parsedCondition.substr(pos, 5) == " and ") {
-            parts.push_back(currentPart);
-            currentPart.clear();
-            pos += 5;
-        } else if (parsedCondition.substr(pos, 4) == " or ") {
-            parts.push_back(currentPart);
-            currentPart.clear();
-            pos += 4;
+void SceneManager::debugPrintVariables() const {
+    std::cout << "\n=== Global Variables ===\n";
+    globalVars.forEachDefined([this](const std::string& name, int slot) {
+        std::cout << name << " = ";
+        if(globalVars.getType(slot) == VariableStore::Type::String) {
+            std::cout << '"' << globalVars.getString(slot) << '"';
         } else {
-            currentPart += parsedCondition[pos];
-            pos++;
+            std::string text;
+            globalVars.appendText(slot, text);
+            std::cout << text;
         }
-    }
-    if (!currentPart.empty()) {
-        parts.push_back(currentPart);
+        std::cout << '\n';
+    });
+    std::cout << "====================\n";
+}
+
+void SceneManager::checkHotReload() {
+    if(pendingDialogReload && dialogSystem && !dialogSystem->isActive()) {
+        loadDialogGroups(currentScene);
+        pendingDialogReload = false;
+        linkScene();
+        journalResetPending = true;
     }
 
-    bool result = true;
-    bool isOr = false;
+    if(!fileWatcher.poll(changedFiles)) return;
+    for(const auto& path : changedFiles) {
+        if(path == "scenes/" + currentSceneName + ".json") {
+            std::cout << "Hot reload: " << path << std::endl;
+            reloadSceneData();
+        } else if(path.compare(0, 6, "image/") == 0) {
+            std::cout << "Hot reload: " << path << std::endl;
+            reloadImage(path.substr(6));
+        } else if(path.compare(0, 5, "font/") == 0 && dialogSystem) {
+            std::cout << "Hot reload: " << path << std::endl;
+            dialogSystem->reloadFont();
+        }
+    }
+}
 
-    for (const auto& part : parts) {
-        std::string trimmed = trim(part);
-        bool partResult;
+void SceneManager::reloadSceneData() {
+    std::ifstream file(gamePath + "/scenes/" + currentSceneName + ".json");
+    json sceneData;
+    try {
+        file >> sceneData;
+    } catch(const std::exception& e) {
+        // Файл могли сохранить наполовину - оставляем старую сцену до следующего сохранения
+        std::cout << "Hot reload: error parsing scene: " << e.what() << std::endl;
+        return;
+    }
+    if(currentSceneType != SceneType::STATIC || sceneData.value("type", "") == "video") {
+        std::cout << "Hot reload: only static scenes are reloaded" << std::endl;
+        return;
+    }
 
-        if (trimmed.substr(0, 1) == "!") {
-            partResult = !evaluateSimpleCondition(trimmed.substr(1));
-        } else {
-            partResult = evaluateSimpleCondition(trimmed);
-        }
+    // Перечитываем только изменившиеся секции. Позиция игрока и глобальные переменные не трогаются
+    auto changed = [&](const char* key) { return sceneData.value(key, json()) != currentScene.value(key, json()); };
 
-        if (isOr) {
-            result = result || partResult;
-            isOr = false;
+    if(changed("backgroundColor")) {
+        const auto& bgColor = sceneData["backgroundColor"];
+        backgroundColor.r = bgColor["r"];
+        backgroundColor.g = bgColor["g"];
+        backgroundColor.b = bgColor["b"];
+        backgroundColor.a = bgColor["a"];
+    }
+    const bool layersChanged = changed("layers");
+    if(layersChanged) {
+        loadLayers(sceneData);
+    }
+    // loadLayers сбрасывает маску, отдельную картинку-маску загружает loadCollisions
+    if(changed("collisions") || changed("collisionMask") || (layersChanged && sceneData.contains("collisionMask"))) {
+        loadCollisions(sceneData);
+        calculateGrid();
+        applyCollisionBindings(-1);
+    }
+    if(changed("ScriptGroups") || changed("InitialScript")) {
+        // Выполняющиеся скрипты останавливаются, начальный скрипт заново не запускается
+        loadScriptGroups(sceneData);
+        loadInitialScript(sceneData);
+    }
+    if(changed("ScriptCells")) {
+        double time = sceneTime;
+        loadScriptCells(sceneData);
+        sceneTime = time;
+        resetTriggerOccupancy();
+    }
+    if(changed("DialogGroups")) {
+        // Открытое окно ссылается на текущие группы - заменим их, когда оно закроется
+        if(dialogSystem && dialogSystem->isActive()) {
+            pendingDialogReload = true;
         } else {
-            result = result && partResult;
+            loadDialogGroups(sceneData);
         }
-
-        if (trimmed.find(" or ") != std::string::npos) {
-            isOr = true;
+    }
+    if(changed("particles")) {
+        loadParticles(sceneData);
+    }
+    if(changed("Watchers")) {
+        // Уже истинные условия не срабатывают повторно, ждут следующего перехода
+        loadWatchers(sceneData);
+        for(auto& watcher : watchers) {
+            watcher.value = watcher.condition.evaluateCondition(globalVars);
         }
     }
 
-    return result;
-}
-
-std::string SceneManager::trim(const std::string& str) {
-    size_t first = str.find_first_not_of(" \t");
-    if (first == std::string::npos) return "";
-    size_t last = str.find_last_not_of(" \t");
-    return str.substr(first, last - first + 1);
+    currentScene = std::move(sceneData);
+    // Индексы групп и эмиттеров могли сдвинуться
+    linkScene();
+    journalResetPending = true;
 }
 
-bool SceneManager::evaluateSimpleCondition(const std::string& condition) {
-    // Handle comparisons
-    if (condition.find(">=") != std::string::npos) {
-        auto parts = splitByOperator(condition, ">=");
-        return compareValues(parts.first, parts.second, ">=");
-    }
-    if (condition.find("<=") != std::string::npos) {
-        auto parts = splitByOperator(condition, "<=");
-        return compareValues(parts.first, parts.second, "<=");
-    }
-    if (condition.find(">") != std::string::npos) {
-        auto parts = splitByOperator(condition, ">");
-        return compareValues(parts.first, parts.second, ">");
+void SceneManager::resetTriggerOccupancy() {
+    for(auto& group : scriptCells) {
+        group.entered = false;
     }
-    if (condition.find("<") != std::string::npos) {
-        auto parts = splitByOperator(condition, "<");
-        return compareValues(parts.first, parts.second, "<");
-    }
-    if (condition.find("==") != std::string::npos) {
-        auto parts = splitByOperator(condition, "==");
-        return compareValues(parts.first, parts.second, "==");
-    }
-    if (condition.find("!=") != std::string::npos) {
-        auto parts = splitByOperator(condition, "!=");
-        return compareValues(parts.first, parts.second, "!=");
+    getPlayerFeetCells(occupiedRow, occupiedLeftCol, occupiedRightCol);
+    collectTriggerGroups(occupiedRow, occupiedLeftCol, occupiedRightCol, occupiedTriggerGroups);
+    for(int index : occupiedTriggerGroups) {
+        scriptCells[index].entered = true;
     }
+}
 
-    // Handle boolean values
-    if (condition == "true") return true;
-    if (condition == "false") return false;
+void SceneManager::reloadImage(const std::string& imageName) {
+    // Текстура меняется в менеджере для всех ссылок, старая удаляется, когда ее не будет в снимках рендера
+    assets.reload(gamePath + "/image/" + imageName);
 
-    // Try to find variable by exact name
-    auto it = globalVars.find(condition);
-    if (it != globalVars.end()) {
-        if (std::holds_alternative<bool>(it->second)) {
-            return std::get<bool>(it->second);
-        }
-        // Convert other types to boolean
-        if (std::holds_alternative<int>(it->second)) {
-            return std::get<int>(it->second) != 0;
-        }
-        if (std::holds_alternative<float>(it->second)) {
-            return std::get<float>(it->second) != 0.0f;
+    bool maskLayerChanged = false;
+    for(auto& layer : layers) {
+        if(layer.image != imageName) continue;
+        if(layer.collisionAlpha >= 0) {
+            maskLayerChanged = true;
+            continue;
         }
-        if (std::holds_alternative<std::string>(it->second)) {
-            return !std::get<std::string>(it->second).empty();
+        layer.width = layer.texture.getWidth();
+        layer.height = layer.texture.getHeight();
+    }
+
+    const bool maskImageChanged = currentScene.contains("collisionMask") &&
+                                  currentScene["collisionMask"].value("image", "") == imageName;
+    if(maskLayerChanged) {
+        // Маска строится из слоя - пересобираем слои и маску целиком
+        loadLayers(currentScene);
+    }
+    if(maskLayerChanged || maskImageChanged) {
+        if(currentScene.contains("collisionMask")) {
+            loadCollisionMask(currentScene["collisionMask"]);
         }
     }
+    updateLayerPlacement();
 
-    return false;
+    if(dialogSystem) {
+        dialogSystem->reloadImage(imageName);
+    }
 }
 
-std::pair<std::string, std::string> SceneManager::splitByOperator(const std::string& condition, const std::string& op) {
-    size_t pos = condition.find(op);
-    if (pos == std::string::npos) {
-        return {condition, ""};
-    }
-    std::string left = trim(condition.substr(0, pos));
-    std::string right = trim(condition.substr(pos + op.length()));
-    return {left, right};
+void SceneManager::debugPrintScriptProfile() const {
+    scripts.printProfile(std::cout);
 }
 
-bool SceneManager::compareValues(const std::string& left, const std::string& right, const std::string& op) {
-    // Convert values to appropriate types
-    auto leftValue = convertToValue(left);
-    auto rightValue = convertToValue(right);
+void SceneManager::debugPrintAssetStats() const {
+    assets.printStats(std::cout);
+}
 
-    if (!leftValue.has_value() || !rightValue.has_value()) {
-        return false;
+void SceneManager::writeScriptProfile(const std::string& path) const {
+    json profile = scripts.profileJson();
+    if(profile["groups"].empty()) return;
+    std::ofstream file(path);
+    if(!file.is_open()) {
+        std::cout << "Failed to write script profile: " << path << std::endl;
+        return;
     }
+    file << profile.dump(2) << std::endl;
+}
 
-    if (op == ">=") return leftValue.value() >= rightValue.value();
-    if (op == "<=") return leftValue.value() <= rightValue.value();
-    if (op == ">") return leftValue.value() > rightValue.value();
-    if (op == "<") return leftValue.value() < rightValue.value();
-    if (op == "==") return leftValue.value() == rightValue.value();
-    if (op == "!=") return leftValue.value() != rightValue.value();
+size_t SceneManager::beginJournalRecord(JournalRecord type) {
+    // Запись: u8 тип, u32 размер, данные
+    const size_t start = journalRecords.size();
+    journalPut(journalRecords, type);
+    journalPut(journalRecords, uint32_t(0));
+    return start;
+}
 
-    return false;
+void SceneManager::endJournalRecord(size_t start) {
+    const uint32_t size = static_cast<uint32_t>(journalRecords.size() - start - sizeof(JournalRecord) - sizeof(uint32_t));
+    std::memcpy(journalRecords.data() + start + sizeof(JournalRecord), &size, sizeof(size));
 }
 
-std::optional<float> SceneManager::convertToValue(const std::string& str) {
-    try {
-        // First try as integer
-        return std::stoi(str);
-    } catch (...) {
-        try {
-            // Then try as float
-            return std::stof(str);
-        } catch (...) {
-            // Not a number, try as variable
-            auto it = globalVars.find(str);
-            if (it != globalVars.end()) {
-                if (std::holds_alternative<int>(it->second)) {
-                    return static_cast<float>(std::get<int>(it->second));
-                }
-                if (std::holds_alternative<float>(it->second)) {
-                    return std::get<float>(it->second);
-                }
-                if (std::holds_alternative<bool>(it->second)) {
-                    return std::get<bool>(it->second) ? 1.0f : 0.0f;
-                }
-            }
-        }
+void SceneManager::journalVariable(int slot) {
+    const size_t start = beginJournalRecord(JournalRecord::Variable);
+    const VariableStore::Type type = globalVars.getType(slot);
+    journalPut(journalRecords, slot);
+    journalPut(journalRecords, type);
+    switch(type) {
+    case VariableStore::Type::Bool: journalPut(journalRecords, globalVars.getBool(slot)); break;
+    case VariableStore::Type::Int: journalPut(journalRecords, globalVars.getInt(slot)); break;
+    case VariableStore::Type::Float: journalPut(journalRecords, globalVars.getFloat(slot)); break;
+    case VariableStore::Type::String: journalPutString(journalRecords, globalVars.getString(slot)); break;
+    default: break;
     }
-    return std::nullopt;
+    endJournalRecord(start);
 }
 
-std::string SceneManager::parseVarString(const std::string& str) {
-    std::string result = str;
-    size_t pos = 0;
-    while ((pos = result.find("{", pos)) != std::string::npos) {
-        size_t endPos = result.find("}", pos);
-        if (endPos == std::string::npos) break;
-        
-        std::string varName = result.substr(pos + 1, endPos - pos - 1);
-        auto it = globalVars.find(varName);
-        if (it != globalVars.end()) {
-            std::string replacement;
-            std::visit([&replacement](const auto& value) {
-                if constexpr (std::is_same_v<std::decay_t<decltype(value)>, bool>)
-                    replacement = value ? "true" : "false";
-                else if constexpr (std::is_arithmetic_v<std::decay_t<decltype(value)>>)
-                    replacement = std::to_string(value);
-                else
-                    replacement = value;
-            }, it->second);
-            
-            result.replace(pos, endPos - pos + 1, replacement);
-        }
-        pos++;
+JournalPlayerState SceneManager::getJournalPlayerState() const {
+    JournalPlayerState state;
+    state.x = player.getX();
+    state.y = player.getY();
+    if(!playerPath.empty()) {
+        state.goalRow = playerPath.back().first;
+        state.goalCol = playerPath.back().second;
     }
-    return result;
+    return state;
 }
 
-SceneManager::VarValue SceneManager::parseJsonValue(const json& value) {
-    if (value.is_boolean())
-        return value.get<bool>();
-    else if (value.is_number_integer())
-        return value.get<int>();
-    else if (value.is_number_float())
-        return value.get<float>();
-    else if (value.is_string())
-        return value.get<std::string>();
-    
-    return false; // default value
+JournalFadeState SceneManager::getJournalFadeState() const {
+    return {fadeAlpha, fadeTarget, fadeSpeed, isFading};
 }
 
-void SceneManager::debugPrintVariables() const {
-    std::cout << "\n=== Global Variables ===\n";
-    for(const auto& [name, value] : globalVars) {
-        std::cout << name << " = ";
-        std::visit([](const auto& v) {
-            if constexpr (std::is_same_v<std::decay_t<decltype(v)>, bool>)
-                std::cout << (v ? "true" : "false");
-            else if constexpr (std::is_arithmetic_v<std::decay_t<decltype(v)>>)
-                std::cout << v;
-            else
-                std::cout << '"' << v << '"';
-        }, value);
-        std::cout << '\n';
-    }
-    std::cout << "====================\n";
+void SceneManager::captureJournalBaseline() {
+    journalPlayer = getJournalPlayerState();
+    journalFade = getJournalFadeState();
+    if(dialogSystem) journalDialog = dialogSystem->getSnapshot();
+    journalScripts.clear();
+    scripts.saveState(journalScripts);
+    journalScriptsVersion = scripts.getVersion();
 }
 
-bool SceneManager::isNumber(const std::string& str) const {
-    if(str.empty()) return false;
-    char* end = nullptr;
-    std::strtof(str.c_str(), &end);
-    return end != str.c_str() && *end == '\0';
+void SceneManager::recordJournal() {
+    if(!journal.isEnabled()) return;
+    if(journalResetPending) {
+        journalResetPending = false;
+        journal.clear(journalTick);
+        journalRecords.clear();
+        captureJournalBaseline();
+        return;
+    }
+
+    // В журнал идут значения до тика, текущие становятся новой точкой сравнения
+    const JournalPlayerState playerState = getJournalPlayerState();
+    if(playerState != journalPlayer) {
+        const size_t start = beginJournalRecord(JournalRecord::Player);
+        journalPut(journalRecords, journalPlayer);
+        endJournalRecord(start);
+        journalPlayer = playerState;
+    }
+    if(dialogSystem) {
+        const DialogSystem::Snapshot dialogState = dialogSystem->getSnapshot();
+        if(dialogState != journalDialog) {
+            const size_t start = beginJournalRecord(JournalRecord::Dialog);
+            journalPut(journalRecords, journalDialog);
+            endJournalRecord(start);
+            journalDialog = dialogState;
+        }
+    }
+    const JournalFadeState fadeState = getJournalFadeState();
+    if(fadeState != journalFade) {
+        const size_t start = beginJournalRecord(JournalRecord::Fade);
+        journalPut(journalRecords, journalFade);
+        endJournalRecord(start);
+        journalFade = fadeState;
+    }
+    // Спящие скрипты версию не меняют - состояние копируется только на тиках, где они выполнялись
+    if(scripts.getVersion() != journalScriptsVersion) {
+        const size_t start = beginJournalRecord(JournalRecord::Scripts);
+        journalRecords.insert(journalRecords.end(), journalScripts.begin(), journalScripts.end());
+        endJournalRecord(start);
+        journalScripts.clear();
+        scripts.saveState(journalScripts);
+        journalScriptsVersion = scripts.getVersion();
+    }
+
+    journal.commit(journalTick, journalRecords);
+    journalRecords.clear();
 }
 
-SceneManager::VarValue SceneManager::evaluateExpression(const std::string& expr) {
-    std::string parsedExpr = parseVarString(expr);
-    
-    // Handle boolean values first
-    if(parsedExpr == "true") return true;
-    if(parsedExpr == "false") return false;
-    
-    // Check for arithmetic operations
-    size_t pos;
-    if((pos = parsedExpr.find('+')) != std::string::npos) {
-        std::string left = trim(parsedExpr.substr(0, pos));
-        std::string right = trim(parsedExpr.substr(pos + 1));
-        
-        float leftVal = 0, rightVal = 0;
-        
-        // Convert left operand
-        if(isNumber(left)) {
-            leftVal = std::stof(left);
-        } else if(auto it = globalVars.find(left); it != globalVars.end()) {
-            if(std::holds_alternative<int>(it->second)) 
-                leftVal = std::get<int>(it->second);
-            else if(std::holds_alternative<float>(it->second))
-                leftVal = std::get<float>(it->second);
+void SceneManager::rewind(float seconds) {
+    if(!journal.isEnabled() || currentSceneType != SceneType::STATIC || isPlayingVideo || journalStep <= 0.0f) {
+        std::cout << "Rewind: not available" << std::endl;
+        return;
+    }
+
+    const uint64_t ticks = static_cast<uint64_t>(seconds / journalStep + 0.5f);
+    const uint64_t target = journalTick > ticks ? journalTick - ticks : 0;
+
+    // Кадры снимаются от новых к старым. Переменные откатываются сразу, из остального
+    // нужно только самое старое значение - его и применяем один раз в конце
+    std::optional<JournalPlayerState> playerState;
+    std::optional<DialogSystem::Snapshot> dialogState;
+    std::optional<JournalFadeState> fadeState;
+    std::vector<uint8_t> scriptState;
+    bool restoreScripts = false;
+    std::vector<size_t> records;
+    const uint64_t reached = journal.rewind(target, [&](const uint8_t* data, size_t size) {
+        records.clear();
+        for(size_t pos = 0; pos < size;) {
+            records.push_back(pos);
+            uint32_t length;
+            std::memcpy(&length, data + pos + sizeof(JournalRecord), sizeof(length));
+            pos += sizeof(JournalRecord) + sizeof(length) + length;
         }
-        
-        // Convert right operand
-        if(isNumber(right)) {
-            rightVal = std::stof(right);
-        } else if(auto it = globalVars.find(right); it != globalVars.end()) {
-            if(std::holds_alternative<int>(it->second))
-                rightVal = std::get<int>(it->second);
-            else if(std::holds_alternative<float>(it->second))
-                rightVal = std::get<float>(it->second);
+        // Внутри тика записи отменяются в обратном порядке
+        for(auto it = records.rbegin(); it != records.rend(); ++it) {
+            JournalReader reader{data, size, *it};
+            const JournalRecord type = reader.get<JournalRecord>();
+            const uint32_t length = reader.get<uint32_t>();
+            switch(type) {
+            case JournalRecord::Variable: {
+                const int slot = reader.get<int>();
+                switch(reader.get<VariableStore::Type>()) {
+                case VariableStore::Type::Bool: globalVars.setBool(slot, reader.get<bool>()); break;
+                case VariableStore::Type::Int: globalVars.setInt(slot, reader.get<int>()); break;
+                case VariableStore::Type::Float: globalVars.setFloat(slot, reader.get<float>()); break;
+                case VariableStore::Type::String: globalVars.setString(slot, reader.getString()); break;
+                default: globalVars.unset(slot); break;
+                }
+                break;
+            }
+            case JournalRecord::Player: playerState = reader.get<JournalPlayerState>(); break;
+            case JournalRecord::Dialog: dialogState = reader.get<DialogSystem::Snapshot>(); break;
+            case JournalRecord::Fade: fadeState = reader.get<JournalFadeState>(); break;
+            case JournalRecord::Scripts:
+                scriptState.assign(data + reader.pos, data + reader.pos + length);
+                restoreScripts = true;
+                break;
+            case JournalRecord::Watcher: {
+                const uint32_t index = reader.get<uint32_t>();
+                if(index < watchers.size()) watchers[index].done = false;
+                break;
+            }
+            }
         }
-        
-        // If both operands are integers, return int
-        if(std::floor(leftVal) == leftVal && std::floor(rightVal) == rightVal) {
-            return static_cast<int>(leftVal + rightVal);
+    });
+
+    const double rewound = static_cast<double>(journalTick - reached) * journalStep;
+    if(playerState) {
+        player.setPosition(playerState->x, playerState->y, player.getSize());
+        const std::pair<int, int> goal{playerState->goalRow, playerState->goalCol};
+        if(goal.first < 0) {
+            // Без stopPlayerWalk: его WalkEnd разбудил бы восстановленные скрипты
+            playerPath.clear();
+            playerPathIndex = 0;
+            player.setAutopilot(false);
+            player.setVelocity(0, 0);
+        } else if(playerPath.empty() || playerPath.back() != goal) {
+            startPlayerWalk(goal);
         }
-        return leftVal + rightVal;
     }
-    
-    // If no arithmetic operations, try to parse as a single value
-    if(isNumber(parsedExpr)) {
-        // Check if it's an integer
-        if(parsedExpr.find('.') == std::string::npos) {
-            return std::stoi(parsedExpr);
-        }
-        return std::stof(parsedExpr);
+    if(dialogState && dialogSystem) {
+        dialogSystem->restoreSnapshot(*dialogState);
     }
-    
-    return parsedExpr; // Return as string if not a number
+    if(fadeState) {
+        fadeAlpha = previousFadeAlpha = fadeState->alpha;
+        fadeTarget = fadeState->target;
+        fadeSpeed = fadeState->speed;
+        isFading = fadeState->fading;
+    }
+    scripts.rewindTime(rewound);
+    if(restoreScripts) {
+        scripts.restoreState(scriptState.data(), scriptState.size());
+    }
+    sceneTime = std::max(0.0, sceneTime - rewound);
+    journalTick = reached;
+
+    // Производное состояние пересчитывается по восстановленным переменным, без запуска скриптов
+    applyCollisionBindings(-1);
+    for(auto& watcher : watchers) {
+        watcher.value = watcher.condition.evaluateCondition(globalVars);
+        watcher.pending = false;
+    }
+    watchersPending = false;
+    resetTriggerOccupancy();
+    captureJournalBaseline();
+    std::cout << "Rewind: " << rewound << " s, " << journal.frameCount() << " frame(s), "
+              << journal.usedBytes() << " bytes left in journal" << std::endl;
 }
 
 bool SceneManager::initializeVideo(const std::string& videoPath) {
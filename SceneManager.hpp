@@ -10,25 +10,39 @@
 #include "VideoPlayer.hpp"
 #include "Player.hpp"
 #include "DialogSystem.hpp"
+#include "ParticleSystem.hpp"
+#include "RenderState.hpp"
+#include "CollisionGrid.hpp"
+#include "CollisionMask.hpp"
+#include "Pathfinder.hpp"
+#include "ScriptProgram.hpp"
+#include "ScriptScheduler.hpp"
+#include "FileWatcher.hpp"
+#include "StateJournal.hpp"
 #include <variant>
 #include <map>
 #include <optional>
 
 using json = nlohmann::json;
 
+class RenderQueue;
+
 enum class SceneType {
     STATIC,
     VIDEO
 };
 
 struct Layer {
-    SDL_Texture* texture;
+    TextureHandle texture;
+    std::string image;       // Имя файла в image/, для горячей перезагрузки
+    int collisionAlpha = -1; // >= 0 - слой задает маску коллизий
     int zIndex;
     Uint8 opacity;
     int width;   // добавляем поле для хранения ширины
     int height;  // добавляем поле для хранения высоты
+    SDL_Rect dstRect;  // Позиция слоя, пересчитывается только при изменении размера окна
     
-    Layer() : texture(nullptr), zIndex(0), opacity(255), width(0), height(0) {}
+    Layer() : zIndex(0), opacity(255), width(0), height(0), dstRect{0, 0, 0, 0} {}
 };
 
 struct GridCell {
@@ -41,55 +55,131 @@ struct GridCell {
     }
 };
 
-struct ScriptCommand {
-    std::string command;
-    json parameter;
-    float time_left = 0.0f;  // Добавляем время ожидания
-    bool isComplete;
-    bool isStarted;  // Добавляем флаг для отслеживания начала выполнения команды
-    
-    ScriptCommand() : isComplete(false), isStarted(false) {}
+// Клетка коллизии, которая включена, пока условие истинно (например, закрытая дверь)
+struct CollisionBinding {
+    int row;
+    int col;
+    CollisionLayer layer;
+    ScriptExpression condition;
+};
+
+// Наблюдатель: запускает группу скриптов, когда условие над переменными становится истинным.
+// Проверяется только при изменении переменных, которые читает условие.
+// Если группа в этот момент еще выполняется, запуск откладывается до ее завершения
+struct VariableWatcher {
+    ScriptExpression condition;
+    std::string scriptGroupName;
+    int script = -1;      // Индекс в scriptGroups, выставляет linkScene
+    bool once = false;    // Сработать один раз за сцену
+    bool value = false;   // Последнее значение условия, запуск - по переходу false -> true
+    bool done = false;
+    bool pending = false; // Переход пришелся на выполнение группы: запуск после ее завершения
 };
 
 struct ScriptGroup {
     std::string name;
-    std::vector<ScriptCommand> commands;
+    ScriptProgram program;
 };
 
 struct ScriptCellGroup {
     std::vector<std::pair<int, int>> cells;
     bool needUseKey;
-    std::string scriptGroupName;
+    std::string scriptGroupName;  // Запускается клавишей использования
+    // Группы скриптов на вход в клетки, выход и пребывание в них
+    std::string onEnter;
+    std::string onExit;
+    std::string onStay;
+    // Индексы тех же групп в scriptGroups, выставляет linkScene; -1 - нет группы
+    int useScript = -1;
+    int enterScript = -1;
+    int exitScript = -1;
+    int stayScript = -1;
+    float cooldown = 0.0f;   // Минимальный интервал между повторными onEnter/onStay, секунды
+    double readyTime = 0.0;  // Время сцены, с которого событие можно запускать снова
+    bool entered = false;    // onEnter уже сработал за текущее пребывание
+};
+
+// Записи журнала отката: старое значение переменной, игрока, окна диалога, затемнения, скриптов;
+// Watcher - индекс наблюдателя once, который сработал (откат снова его включает)
+enum class JournalRecord : uint8_t {
+    Variable,
+    Player,
+    Dialog,
+    Fade,
+    Scripts,
+    Watcher
 };
 
-struct InitialScriptData {
-    std::vector<ScriptCommand> commands;
+struct JournalPlayerState {
+    float x = 0.0f;
+    float y = 0.0f;
+    int goalRow = -1;  // Цель walkTo, -1 - игрок не идет по пути
+    int goalCol = -1;
+
+    bool operator!=(const JournalPlayerState& other) const {
+        return x != other.x || y != other.y || goalRow != other.goalRow || goalCol != other.goalCol;
+    }
+};
+
+struct JournalFadeState {
+    float alpha = 0.0f;
+    float target = 0.0f;
+    float speed = 0.0f;
+    bool fading = false;
+
+    bool operator!=(const JournalFadeState& other) const {
+        return alpha != other.alpha || target != other.target || speed != other.speed || fading != other.fading;
+    }
 };
 
 class SceneManager {
 public:
-    SceneManager(SDL_Renderer* renderer);
+    SceneManager(SDL_Renderer* renderer, RenderQueue* renderQueue);
     ~SceneManager();
 
     bool loadScene(const std::string& sceneName);
     void update();
-    void render();
+    // Поток симуляции снимает состояние, поток рендера рисует только по снимку
+    void captureRenderState(RenderState& state) const;
+    void render(const RenderState& state, float alpha);
     void setGamePath(const std::string& path);  // Убираем inline реализацию
+    void setRandomSeed(Uint32 seed) { randomSeed = seed; }
+    // Следить за файлами игры и применять изменения текущей сцены на лету
+    void enableHotReload();
     const GridCell* getCellAt(int row, int col) const;
     const GridCell* getCellAtPosition(int x, int y) const;
     void calculateGrid();
+    void setOutputSize(int width, int height);
     void updatePlayerVelocity(float dx, float dy);
     void update(float deltaTime);
     bool isCollision(float x, float y) const;
+    // Свип прямоугольника вдоль одной оси: доля пути [0, 1], которую можно пройти до касания
+    float sweepX(const SDL_FRect& box, float dx) const;
+    float sweepY(const SDL_FRect& box, float dy) const;
     std::pair<int, int> getCurrentPlayerCell() const;
     void useCurrentCell();
     void toggleDialog(const std::string& dialogName);
     void handleUseKey();
     void debugPrintVariables() const;
+    void debugPrintScriptProfile() const;
+    void debugPrintAssetStats() const;
+    // Профиль скриптов в JSON; ничего не пишет, если скрипты не запускались
+    void writeScriptProfile(const std::string& path) const;
+    // Бюджет журнала отката в байтах, 0 - выключен
+    void setJournalBudget(size_t bytes) { journal.setBudget(bytes); }
+    // Откатывает переменные, игрока, скрипты, диалог и затемнение на seconds назад
+    void rewind(float seconds);
 
 private:
     SDL_Renderer* renderer;
+    RenderQueue* renderQueue;
+    // Все текстуры сцены, игрока и диалогов; объявлен раньше владельцев ссылок, чтобы пережить их
+    AssetManager assets;
     json currentScene;
+    std::string currentSceneName;
+    FileWatcher fileWatcher;
+    std::vector<std::string> changedFiles;
+    bool pendingDialogReload = false;  // Диалоги сцены изменились, пока окно диалога было открыто
     SDL_Color backgroundColor;
     std::string gamePath = ".";
     SceneType currentSceneType;
@@ -97,76 +187,157 @@ private:
     Uint32 nextFrameTime;
     bool showGrid;
     static const int GRID_SIZE = 48;
+    int outputWidth;   // Размер области вывода, обновляется из SDL_WINDOWEVENT
+    int outputHeight;
+    SDL_Rect fadeRect;
     
     VideoPlayer* videoPlayer;
-    SDL_Texture* backgroundTexture;
+    TextureHandle backgroundTexture;
     std::vector<Layer> layers;
     std::vector<std::vector<GridCell>> grid;
     int gridRows;
     int gridCols;
     Player player;
-    std::vector<std::pair<int, int>> collisionCells;
+    CollisionGrid collisionGrid;
+    CollisionMask collisionMask;  // Попиксельные коллизии из альфы слоя или картинки-маски
+    int collisionMaskX = 0;       // Положение маски на экране, центрируется как слои
+    int collisionMaskY = 0;
+    std::vector<CollisionBinding> collisionBindings;
+    VariableDependents bindingDependents;  // Слот переменной -> индексы в collisionBindings
+    std::vector<SDL_Rect> collisionDebugRects;  // Пересобирается только при изменении сетки
+    uint64_t collisionDebugVersion = ~uint64_t(0);
+    // Слои, через которые игрок не проходит
+    static constexpr uint32_t PLAYER_BLOCKING_LAYERS = (1u << static_cast<uint32_t>(CollisionLayer::Solid)) |
+                                                       (1u << static_cast<uint32_t>(CollisionLayer::Water));
+    Pathfinder pathfinder;
+    // Путь игрока по команде walkTo: клетки {row, col}, первая - текущая клетка
+    std::vector<std::pair<int, int>> playerPath;
+    size_t playerPathIndex = 0;
+    uint64_t playerPathVersion = 0;  // Версия сетки коллизий, для которой путь построен
+    float playerStuckTime = 0.0f;
     std::vector<ScriptCellGroup> scriptCells;
+    // Индекс триггеров: для клетки (row * triggerCols + col) группы лежат в
+    // triggerCellGroups[triggerCellStart[i] .. triggerCellStart[i + 1])
+    int triggerRows = 0;
+    int triggerCols = 0;
+    std::vector<int> triggerCellStart;
+    std::vector<int> triggerCellGroups;
+    std::vector<SDL_Rect> scriptCellDebugRects;
+    // Клетки под ногами игрока на прошлом тике и группы, в которых он сейчас стоит
+    int occupiedRow = -1;
+    int occupiedLeftCol = -1;
+    int occupiedRightCol = -1;
+    std::vector<int> occupiedTriggerGroups;
+    std::vector<int> nextTriggerGroups;
+    double sceneTime = 0.0;  // Время симуляции с загрузки сцены, для кулдаунов триггеров
     std::vector<ScriptGroup> scriptGroups;
+    std::vector<VariableWatcher> watchers;
+    VariableDependents watcherDependents;  // Слот переменной -> индексы в watchers
+    bool watchersPending = false;          // У какого-то наблюдателя отложен запуск
     std::vector<DialogGroup> dialogGroups;
+    std::vector<ParticleEmitter> particleEmitters;
+    std::vector<int> particleIndices;  // Индексы квадов частиц для renderBatch; только поток рендера
+    Uint32 randomSeed = 0;  // Смешивается с seed эмиттеров, задается для headless-прогонов
     DialogSystem* dialogSystem;
-    std::vector<ScriptCommand> activeCommands; // Очередь активных команд
-    InitialScriptData initialScript;
+    ScriptScheduler scripts;  // Все выполняемые сейчас скрипты
+    ScriptProgram initialScript;
     
     // Добавляем поля для эффекта fade
     float fadeAlpha = 0.0f;
+    float previousFadeAlpha = 0.0f;
     float fadeTarget = 0.0f;
     float fadeSpeed = 0.0f;
     bool isFading = false;
 
-    // Используем variant для хранения разных типов
-    using VarValue = std::variant<bool, int, float, std::string>;
-    std::map<std::string, VarValue> globalVars;
+    // Глобальные переменные по слотам, живут между сценами.
+    // Скрипты и условия коллизий получают номера слотов при загрузке
+    VariableStore globalVars;
+    std::string scriptText;  // Буфер для строк с подстановкой переменных
+
+    // Журнал отката. Переменные пишутся при присваивании, остальное сравнивается
+    // в конце тика с последним записанным состоянием
+    StateJournal journal;
+    std::vector<uint8_t> journalRecords;  // Записи текущего тика
+    uint64_t journalTick = 0;
+    float journalStep = 0.0f;           // Шаг последнего тика, для перевода секунд отката в тики
+    bool journalResetPending = false;   // Историю нельзя откатить через загрузку, перезагрузку и видео
+    JournalPlayerState journalPlayer;
+    DialogSystem::Snapshot journalDialog;
+    JournalFadeState journalFade;
+    std::vector<uint8_t> journalScripts;
+    uint64_t journalScriptsVersion = 0;
     
     void loadGlobalVars(const json& sceneData);
-    bool evaluateCondition(const std::string& condition);
-    std::string parseVarString(const std::string& str);
-    VarValue parseJsonValue(const json& value);
+    size_t beginJournalRecord(JournalRecord type);
+    void endJournalRecord(size_t start);
+    void journalVariable(int slot);
+    void recordJournal();
+    void captureJournalBaseline();
+    JournalPlayerState getJournalPlayerState() const;
+    JournalFadeState getJournalFadeState() const;
+    // Игрок уже стоит в клетках (после перезагрузки или отката) - вход в них не повторяем
+    void resetTriggerOccupancy();
 
     void loadVideoScene(const json& sceneData);
     void loadStaticScene(const json& sceneData);
-    void drawGrid();
+    void drawGrid(const RenderState& state);
     void loadBackgroundImage(const std::string& imagePath);
     void cleanupBackground();
     void loadLayers(const json& sceneData);
     void cleanupLayers();
-    bool loadLayerImage(Layer& layer, const std::string& imagePath);
+    bool loadLayerImage(Layer& layer, const std::string& imagePath, int collisionAlpha = -1);
+    void updateLayerPlacement();
+    void rasterizeCollisionMask();
     void initializeGrid();
     void initializePlayer(const json& sceneData);
     void updatePlayerPosition();
     void renderPlayer();
     void loadCollisions(const json& sceneData);
+    void loadCollisionMask(const json& maskData);
+    // slot < 0 - пересчитать все привязки
+    void applyCollisionBindings(int slot);
+    // Переменную изменил скрипт: пересчитываем только зависящие от нее привязки и наблюдатели
+    void notifyVariableChanged(int slot);
+    void loadWatchers(const json& sceneData);
+    void checkWatcher(VariableWatcher& watcher);
+    // Наблюдатель запустил группу: once выключается до конца сцены (или до отката)
+    void markWatcherFired(VariableWatcher& watcher);
+    // Отложенные запуски наблюдателей, чьи группы уже завершились
+    void retryPendingWatchers();
+    void setCollisionCell(int row, int col, CollisionLayer layer, bool value);
+    bool startPlayerWalk(std::pair<int, int> goal);
+    void updatePlayerWalk(float deltaTime);
+    void stopPlayerWalk();
+    void rebuildCollisionDebugRects();
     void loadScriptCells(const json& sceneData);
-    void checkPlayerInScriptCells() const;
+    void buildTriggerIndex();
+    void getPlayerFeetCells(int& row, int& leftCol, int& rightCol) const;
+    void collectTriggerGroups(int row, int leftCol, int rightCol, std::vector<int>& groups) const;
+    void updateScriptTriggers();
+    bool fireTrigger(ScriptCellGroup& group, int scriptGroup);
     void loadScriptGroups(const json& sceneData);
-    void executeScriptGroup(const std::string& groupName);
-    void executeCommand(const ScriptCommand& command);
+    bool executeScriptGroup(int index);
     void loadDialogGroups(const json& sceneData);
-    void updateActiveCommands(float deltaTime);  // Обновляем сигнатуру метода
-    bool isCommandComplete(const ScriptCommand& command) const;
-    void startCommand(ScriptCommand& command);
+    void loadParticles(const json& sceneData);
+    // Прикладная инструкция скрипта; возвращает событие, до которого скрипт спит
+    ScriptEvent executeInstruction(const ScriptProgram& program, const ScriptInstruction& ins);
+    // Строка или шаблон из пулов программы, в зависимости от SCRIPT_FLAG_INTERPOLATE
+    const std::string& scriptString(const ScriptProgram& program, uint16_t index, uint8_t flag);
     void loadInitialScript(const json& sceneData);
-    void renderFadeEffect();
+    void checkHotReload();
+    void reloadSceneData();
+    void reloadImage(const std::string& imageName);
+    // Линковка: имена групп, эмиттеров и файлов в сцене превращаются в индексы,
+    // битые ссылки выводятся сразу после загрузки. Во время игры поиска по имени нет
+    void linkScene();
+    int linkProgram(ScriptProgram& program);
+    int findScriptGroup(const std::string& name) const;
+    int findDialogGroup(const std::string& name) const;
+    int findEmitter(const std::string& name) const;
+    void openDialog(int index);
+    void renderFadeEffect(const RenderState& state, float alpha);
     bool updateFade(float deltaTime);
 
-    std::string trim(const std::string& str);
-    bool evaluateSimpleCondition(const std::string& condition);
-    std::pair<std::string, std::string> splitByOperator(const std::string& condition, const std::string& op);
-    bool compareValues(const std::string& left, const std::string& right, const std::string& op);
-    std::optional<float> convertToValue(const std::string& str);
-
-    void processScriptCommands(const std::vector<ScriptCommand>& commands);
-    void processCommand(const json& cmd);
-
-    bool isExecutingScript = false;
-
-    VarValue evaluateExpression(const std::string& expr);
-    bool isNumber(const std::string& str) const;
 
     bool isPlayingVideo = false;
     bool initializeVideo(const std::string& videoPath);
@@ -0,0 +1,420 @@
+#include "ScriptExpression.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+ExprValue ExprValue::fromSlot(const VariableStore& variables, int slot) {
+    switch(variables.getType(slot)) {
+    case VariableStore::Type::Bool: return fromBool(variables.getBool(slot));
+    case VariableStore::Type::Int: return fromInt(variables.getInt(slot));
+    case VariableStore::Type::Float: return fromFloat(variables.getFloat(slot));
+    case VariableStore::Type::String: return fromString(&variables.getString(slot));
+    default: return fromBool(false);  // Неопределенная переменная - false, как и раньше в условиях
+    }
+}
+
+bool ExprValue::truthy() const {
+    switch(type) {
+    case Type::Bool: return boolValue;
+    case Type::Int: return intValue != 0;
+    case Type::Float: return floatValue != 0.0f;
+    case Type::String: return !stringValue->empty();
+    }
+    return false;
+}
+
+float ExprValue::asFloat() const {
+    switch(type) {
+    case Type::Bool: return boolValue ? 1.0f : 0.0f;
+    case Type::Int: return static_cast<float>(intValue);
+    case Type::Float: return floatValue;
+    case Type::String: return 0.0f;
+    }
+    return 0.0f;
+}
+
+ScriptVarValue ExprValue::toVar() const {
+    switch(type) {
+    case Type::Bool: return boolValue;
+    case Type::Int: return intValue;
+    case Type::Float: return floatValue;
+    case Type::String: return *stringValue;
+    }
+    return false;
+}
+
+// Рекурсивный спуск по уровням приоритета. Работает только при компиляции.
+class ExpressionParser {
+public:
+    ExpressionParser(ScriptExpression& expression, const std::string& text, VariableStore& variables)
+        : expr(expression), text(text), variables(variables), pos(0) {}
+
+    int32_t parse(std::string& error) {
+        int32_t root = parseOr();
+        skipSpaces();
+        if(root >= 0 && pos != text.size()) {
+            fail("unexpected '" + text.substr(pos, 1) + "'");
+            root = -1;
+        }
+        if(root < 0) error = message;
+        return root;
+    }
+
+private:
+    using Op = ScriptExpression::Op;
+
+    ScriptExpression& expr;
+    const std::string& text;
+    VariableStore& variables;
+    size_t pos;
+    std::string message;
+
+    void fail(const std::string& what) {
+        if(message.empty()) message = what + " at " + std::to_string(pos);
+    }
+
+    void skipSpaces() {
+        while(pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+    }
+
+    // Символьный оператор
+    bool match(const char* token) {
+        skipSpaces();
+        size_t length = std::char_traits<char>::length(token);
+        if(text.compare(pos, length, token) != 0) return false;
+        pos += length;
+        return true;
+    }
+
+    // Словесный оператор (and, or, not): не должен быть началом более длинного имени
+    bool matchWord(const char* word) {
+        skipSpaces();
+        size_t length = std::char_traits<char>::length(word);
+        if(text.compare(pos, length, word) != 0) return false;
+        if(pos + length < text.size() && isNameChar(text[pos + length])) return false;
+        pos += length;
+        return true;
+    }
+
+    static bool isNameChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+    }
+
+    // Ошибка в операнде (-1) пробрасывается наверх
+    int32_t node(Op op, int32_t left, int32_t right) {
+        bool unary = op == Op::Not || op == Op::Neg;
+        if(left < 0 || (!unary && right < 0)) return -1;
+        expr.nodes.push_back({op, 0, left, right});
+        return static_cast<int32_t>(expr.nodes.size() - 1);
+    }
+
+    int32_t constant(const ExprValue& value) {
+        expr.constants.push_back(value);
+        expr.nodes.push_back({Op::Const, static_cast<uint16_t>(expr.constants.size() - 1), -1, -1});
+        return static_cast<int32_t>(expr.nodes.size() - 1);
+    }
+
+    int32_t variable(const std::string& name) {
+        int slot = variables.resolve(name);
+        auto it = std::find(expr.variableSlots.begin(), expr.variableSlots.end(), slot);
+        size_t index = it - expr.variableSlots.begin();
+        if(it == expr.variableSlots.end()) expr.variableSlots.push_back(slot);
+        expr.nodes.push_back({Op::Var, static_cast<uint16_t>(index), -1, -1});
+        return static_cast<int32_t>(expr.nodes.size() - 1);
+    }
+
+    int32_t parseOr() {
+        int32_t left = parseAnd();
+        while(left >= 0 && (matchWord("or") || match("||"))) {
+            left = node(Op::Or, left, parseAnd());
+        }
+        return left;
+    }
+
+    int32_t parseAnd() {
+        int32_t left = parseNot();
+        while(left >= 0 && (matchWord("and") || match("&&"))) {
+            left = node(Op::And, left, parseNot());
+        }
+        return left;
+    }
+
+    // Отрицание слабее сравнения: "!a == b" - это !(a == b), как в старых условиях
+    int32_t parseNot() {
+        skipSpaces();
+        if(text.compare(pos, 1, "!") == 0 && text.compare(pos, 2, "!=") != 0) {
+            pos++;
+            return node(Op::Not, parseNot(), -1);
+        }
+        if(matchWord("not")) {
+            return node(Op::Not, parseNot(), -1);
+        }
+        return parseComparison();
+    }
+
+    int32_t parseComparison() {
+        int32_t left = parseAdditive();
+        if(left < 0) return -1;
+        // Двухсимвольные операторы проверяем раньше односимвольных
+        if(match("==")) return node(Op::Eq, left, parseAdditive());
+        if(match("!=")) return node(Op::Ne, left, parseAdditive());
+        if(match("<=")) return node(Op::Le, left, parseAdditive());
+        if(match(">=")) return node(Op::Ge, left, parseAdditive());
+        if(match("<")) return node(Op::Lt, left, parseAdditive());
+        if(match(">")) return node(Op::Gt, left, parseAdditive());
+        return left;
+    }
+
+    int32_t parseAdditive() {
+        int32_t left = parseMultiplicative();
+        while(left >= 0) {
+            if(match("+")) left = node(Op::Add, left, parseMultiplicative());
+            else if(match("-")) left = node(Op::Sub, left, parseMultiplicative());
+            else break;
+        }
+        return left;
+    }
+
+    int32_t parseMultiplicative() {
+        int32_t left = parseUnary();
+        while(left >= 0) {
+            if(match("*")) left = node(Op::Mul, left, parseUnary());
+            else if(match("/")) left = node(Op::Div, left, parseUnary());
+            else if(match("%")) left = node(Op::Mod, left, parseUnary());
+            else break;
+        }
+        return left;
+    }
+
+    int32_t parseUnary() {
+        if(match("-")) return node(Op::Neg, parseUnary(), -1);
+        return parsePrimary();
+    }
+
+    int32_t parsePrimary() {
+        skipSpaces();
+        if(pos >= text.size()) {
+            fail("unexpected end");
+            return -1;
+        }
+
+        char c = text[pos];
+        if(c == '(') {
+            pos++;
+            int32_t inner = parseOr();
+            if(inner >= 0 && !match(")")) {
+                fail("')' expected");
+                return -1;
+            }
+            return inner;
+        }
+
+        if(c == '\'' || c == '"') {
+            size_t end = text.find(c, pos + 1);
+            if(end == std::string::npos) {
+                fail("unterminated string");
+                return -1;
+            }
+            expr.strings.push_back(text.substr(pos + 1, end - pos - 1));
+            pos = end + 1;
+            // Строковая константа хранит индекс в пуле строк, указатель берется при вычислении
+            ExprValue value = ExprValue::fromString(nullptr);
+            value.intValue = static_cast<int>(expr.strings.size() - 1);
+            return constant(value);
+        }
+
+        if(c == '{') {
+            // {name} - ссылка на переменную в старом стиле подстановки
+            size_t end = text.find('}', pos);
+            if(end == std::string::npos) {
+                fail("'}' expected");
+                return -1;
+            }
+            std::string name = text.substr(pos + 1, end - pos - 1);
+            pos = end + 1;
+            return variable(name);
+        }
+
+        if(std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            // Только десятичная запись: цифры, дробная часть, порядок. strtof сам по себе
+            // принял бы и 0x10, и inf, поэтому границу числа находим сами
+            size_t end = pos;
+            size_t digits = 0;
+            bool isFloat = false;
+            auto skipDigits = [&] {
+                size_t count = 0;
+                while(end < text.size() && std::isdigit(static_cast<unsigned char>(text[end]))) {
+                    end++;
+                    count++;
+                }
+                return count;
+            };
+            digits += skipDigits();
+            if(end < text.size() && text[end] == '.') {
+                end++;
+                isFloat = true;
+                digits += skipDigits();
+            }
+            if(digits > 0 && end < text.size() && (text[end] == 'e' || text[end] == 'E')) {
+                end++;
+                if(end < text.size() && (text[end] == '+' || text[end] == '-')) end++;
+                if(skipDigits() == 0) digits = 0;
+                isFloat = true;
+            }
+            if(digits == 0 || (end < text.size() && isNameChar(text[end]))) {
+                while(end < text.size() && isNameChar(text[end])) end++;
+                fail("bad number '" + text.substr(pos, end - pos) + "'");
+                return -1;
+            }
+
+            std::string number = text.substr(pos, end - pos);
+            if(isFloat) {
+                pos = end;
+                return constant(ExprValue::fromFloat(std::strtof(number.c_str(), nullptr)));
+            }
+            errno = 0;
+            long value = std::strtol(number.c_str(), nullptr, 10);
+            if(errno == ERANGE || value > INT_MAX) {
+                fail("number out of range '" + number + "'");
+                return -1;
+            }
+            pos = end;
+            return constant(ExprValue::fromInt(static_cast<int>(value)));
+        }
+
+        if(isNameChar(c)) {
+            size_t start = pos;
+            while(pos < text.size() && isNameChar(text[pos])) pos++;
+            std::string name = text.substr(start, pos - start);
+            if(name == "true") return constant(ExprValue::fromBool(true));
+            if(name == "false") return constant(ExprValue::fromBool(false));
+            return variable(name);
+        }
+
+        fail("unexpected '" + std::string(1, c) + "'");
+        return -1;
+    }
+};
+
+bool ScriptExpression::compile(const std::string& text, std::string& error, VariableStore& variables) {
+    source = text;
+    nodes.clear();
+    constants.clear();
+    strings.clear();
+    variableSlots.clear();
+
+    ExpressionParser parser(*this, source, variables);
+    root = parser.parse(error);
+    return root >= 0;
+}
+
+bool ScriptExpression::readsVariable(int slot) const {
+    return std::find(variableSlots.begin(), variableSlots.end(), slot) != variableSlots.end();
+}
+
+void ScriptExpression::assignTo(VariableStore& variables, int target) const {
+    // Одно слово, не являющееся переменной, - строка (setVar ["v", "hello"])
+    if(root >= 0 && nodes[root].op == Op::Var) {
+        int slot = variableSlots[nodes[root].index];
+        if(!variables.isDefined(slot)) {
+            variables.setString(target, variables.getName(slot));
+            return;
+        }
+    }
+
+    // Строка результата может смотреть в хранилище: setString это учитывает
+    const ExprValue value = evaluate(variables);
+    switch(value.type) {
+    case ExprValue::Type::Bool: variables.setBool(target, value.boolValue); break;
+    case ExprValue::Type::Int: variables.setInt(target, value.intValue); break;
+    case ExprValue::Type::Float: variables.setFloat(target, value.floatValue); break;
+    case ExprValue::Type::String: variables.setString(target, *value.stringValue); break;
+    }
+}
+
+ExprValue ScriptExpression::evaluate(const VariableStore& variables) const {
+    if(root < 0) return ExprValue::fromBool(false);
+    return evaluateNode(root, variables);
+}
+
+// Целая арифметика скриптов 32-битная с переполнением по модулю 2^32, как у счетчиков в игре:
+// считаем в int64_t и отбрасываем старшие биты, без неопределенного поведения int
+static ExprValue wrapInt(int64_t value) {
+    return ExprValue::fromInt(static_cast<int32_t>(static_cast<uint32_t>(value)));
+}
+
+ExprValue ScriptExpression::evaluateNode(int32_t index, const VariableStore& variables) const {
+    const Node& n = nodes[index];
+    using Type = ExprValue::Type;
+
+    switch(n.op) {
+    case Op::Const: {
+        const ExprValue& value = constants[n.index];
+        if(value.type == Type::String) return ExprValue::fromString(&strings[value.intValue]);
+        return value;
+    }
+    case Op::Var:
+        return ExprValue::fromSlot(variables, variableSlots[n.index]);
+    case Op::Not:
+        return ExprValue::fromBool(!evaluateNode(n.left, variables).truthy());
+    case Op::Neg: {
+        ExprValue v = evaluateNode(n.left, variables);
+        if(v.type == Type::Int) return wrapInt(-static_cast<int64_t>(v.intValue));
+        return ExprValue::fromFloat(-v.asFloat());
+    }
+    case Op::And:
+        // Короткое замыкание, как в C++
+        return ExprValue::fromBool(evaluateNode(n.left, variables).truthy() && evaluateNode(n.right, variables).truthy());
+    case Op::Or:
+        return ExprValue::fromBool(evaluateNode(n.left, variables).truthy() || evaluateNode(n.right, variables).truthy());
+    default:
+        break;
+    }
+
+    const ExprValue left = evaluateNode(n.left, variables);
+    const ExprValue right = evaluateNode(n.right, variables);
+
+    // Строки сравниваются только со строками; строка и число равны не бывают
+    if(left.type == Type::String || right.type == Type::String) {
+        bool bothStrings = left.type == Type::String && right.type == Type::String;
+        switch(n.op) {
+        case Op::Eq: return ExprValue::fromBool(bothStrings && *left.stringValue == *right.stringValue);
+        case Op::Ne: return ExprValue::fromBool(!bothStrings || *left.stringValue != *right.stringValue);
+        case Op::Lt: return ExprValue::fromBool(bothStrings && *left.stringValue < *right.stringValue);
+        case Op::Le: return ExprValue::fromBool(bothStrings && *left.stringValue <= *right.stringValue);
+        case Op::Gt: return ExprValue::fromBool(bothStrings && *left.stringValue > *right.stringValue);
+        case Op::Ge: return ExprValue::fromBool(bothStrings && *left.stringValue >= *right.stringValue);
+        default: return ExprValue::fromInt(0);  // Арифметика над строками не определена
+        }
+    }
+
+    // Целые остаются целыми, иначе считаем во float. bool участвует как 0/1
+    const bool integers = left.type != Type::Float && right.type != Type::Float;
+    const int64_t li = left.type == Type::Bool ? left.boolValue : left.intValue;
+    const int64_t ri = right.type == Type::Bool ? right.boolValue : right.intValue;
+    const float lf = left.asFloat();
+    const float rf = right.asFloat();
+
+    switch(n.op) {
+    case Op::Add: return integers ? wrapInt(li + ri) : ExprValue::fromFloat(lf + rf);
+    case Op::Sub: return integers ? wrapInt(li - ri) : ExprValue::fromFloat(lf - rf);
+    case Op::Mul: return integers ? wrapInt(li * ri) : ExprValue::fromFloat(lf * rf);
+    // Деление на ноль дает 0, а не исключение. Делитель -1 - отдельно: INT_MIN / -1 в int - SIGFPE
+    case Op::Div:
+        if(integers) return ri == 0 ? ExprValue::fromInt(0) : ri == -1 ? wrapInt(-li) : wrapInt(li / ri);
+        return ExprValue::fromFloat(rf != 0.0f ? lf / rf : 0.0f);
+    case Op::Mod:
+        if(integers) return ExprValue::fromInt(ri == 0 || ri == -1 ? 0 : static_cast<int>(li % ri));
+        return ExprValue::fromFloat(rf != 0.0f ? std::fmod(lf, rf) : 0.0f);
+    case Op::Eq: return ExprValue::fromBool(integers ? li == ri : lf == rf);
+    case Op::Ne: return ExprValue::fromBool(integers ? li != ri : lf != rf);
+    case Op::Lt: return ExprValue::fromBool(integers ? li < ri : lf < rf);
+    case Op::Le: return ExprValue::fromBool(integers ? li <= ri : lf <= rf);
+    case Op::Gt: return ExprValue::fromBool(integers ? li > ri : lf > rf);
+    case Op::Ge: return ExprValue::fromBool(integers ? li >= ri : lf >= rf);
+    default: return ExprValue::fromBool(false);
+    }
+}
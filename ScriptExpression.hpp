@@ -0,0 +1,82 @@
+#ifndef ScriptExpression_hpp
+#define ScriptExpression_hpp
+
+#include "VariableStore.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Результат вычисления выражения. Строки не копируются: указатель смотрит
+// в пул выражения или в хранилище переменных, поэтому вычисление не аллоцирует память.
+struct ExprValue {
+    enum class Type : uint8_t { Bool, Int, Float, String };
+
+    Type type = Type::Bool;
+    bool boolValue = false;
+    int intValue = 0;
+    float floatValue = 0.0f;
+    const std::string* stringValue = nullptr;
+
+    static ExprValue fromBool(bool value) { ExprValue v; v.type = Type::Bool; v.boolValue = value; return v; }
+    static ExprValue fromInt(int value) { ExprValue v; v.type = Type::Int; v.intValue = value; return v; }
+    static ExprValue fromFloat(float value) { ExprValue v; v.type = Type::Float; v.floatValue = value; return v; }
+    static ExprValue fromString(const std::string* value) { ExprValue v; v.type = Type::String; v.stringValue = value; return v; }
+    static ExprValue fromSlot(const VariableStore& variables, int slot);
+
+    bool isNumber() const { return type != Type::String; }
+    bool truthy() const;
+    float asFloat() const;
+    ScriptVarValue toVar() const;
+};
+
+// Условие или выражение скрипта, разобранное один раз в дерево.
+// Приоритет операторов (от низкого к высокому):
+//   or ||  /  and &&  /  ! not  /  == != < <= > >=  /  + -  /  * / %  /  унарный минус
+// Операнды: десятичные числа (1, 2.5, 1e3), true/false, строки в '...' или "...", переменные (name или {name}), скобки.
+// Имена переменных превращаются в слоты хранилища при компиляции.
+// Неопределенная на момент вычисления переменная равна false.
+class ScriptExpression {
+public:
+    // false и текст ошибки, если строку не удалось разобрать
+    bool compile(const std::string& source, std::string& error, VariableStore& variables);
+
+    ExprValue evaluate(const VariableStore& variables) const;
+    bool evaluateCondition(const VariableStore& variables) const { return evaluate(variables).truthy(); }
+    // setVar: записывает значение в слот target.
+    // Выражение целиком из одного неопределенного имени дает строку с этим именем
+    void assignTo(VariableStore& variables, int target) const;
+
+    bool isValid() const { return root >= 0; }
+    const std::string& getSource() const { return source; }
+    // Слоты переменных, которые читает выражение
+    const std::vector<int>& getVariables() const { return variableSlots; }
+    bool readsVariable(int slot) const;
+
+private:
+    enum class Op : uint8_t {
+        Const, Var, Not, Neg,
+        Add, Sub, Mul, Div, Mod,
+        Eq, Ne, Lt, Le, Gt, Ge,
+        And, Or
+    };
+
+    struct Node {
+        Op op;
+        uint16_t index;  // Const - индекс в constants, Var - в variableSlots
+        int32_t left;
+        int32_t right;
+    };
+
+    std::string source;
+    std::vector<Node> nodes;
+    std::vector<ExprValue> constants;
+    std::vector<std::string> strings;  // Строковые константы, на них ссылаются constants
+    std::vector<int> variableSlots;
+    int32_t root = -1;
+
+    ExprValue evaluateNode(int32_t index, const VariableStore& variables) const;
+
+    friend class ExpressionParser;
+};
+
+#endif
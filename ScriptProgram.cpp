@@ -0,0 +1,193 @@
+#include "ScriptProgram.hpp"
+#include "CollisionGrid.hpp"
+#include <iostream>
+
+const char* scriptOpName(ScriptOp op) {
+    switch(op) {
+    case ScriptOp::End: return "end";
+    case ScriptOp::Jump: return "jump";
+    case ScriptOp::JumpIfFalse: return "if";
+    case ScriptOp::ShowDialog: return "showDialog";
+    case ScriptOp::DebugMessage: return "showDebugMessage";
+    case ScriptOp::Wait: return "wait";
+    case ScriptOp::PlayerMovement: return "playerMovement";
+    case ScriptOp::FadeIn: return "fadeIn";
+    case ScriptOp::FadeOut: return "fadeOut";
+    case ScriptOp::SetVar: return "setVar";
+    case ScriptOp::SetCollision: return "setCollision";
+    case ScriptOp::WalkTo: return "walkTo";
+    case ScriptOp::ShowVideo: return "showVid";
+    case ScriptOp::Particles: return "particles";
+    case ScriptOp::ParticleBurst: return "particleBurst";
+    case ScriptOp::Parallel: return "parallel";
+    case ScriptOp::Race: return "race";
+    }
+    return "?";
+}
+
+void ScriptCompiler::compile(const json& commands, const std::string& name, ScriptProgram& program, VariableStore& variables) {
+    program.name = name;
+    program.code.clear();
+    program.strings.clear();
+    program.templates.clear();
+    program.expressions.clear();
+    ScriptCompiler compiler(program, variables);
+    compiler.compileBlock(commands);
+    program.code.push_back({});  // ScriptOp::End
+}
+
+void ScriptCompiler::compileBlock(const json& commands) {
+    if(!commands.is_array()) {
+        std::cout << "Script " << program.name << ": command list expected" << std::endl;
+        return;
+    }
+    for(const auto& cmdData : commands) {
+        for(auto it = cmdData.begin(); it != cmdData.end(); ++it) {
+            try {
+                compileCommand(it.key(), it.value());
+            } catch(const std::exception& e) {
+                std::cout << "Script " << program.name << ": bad parameters for "
+                          << it.key() << ": " << e.what() << std::endl;
+            }
+        }
+    }
+}
+
+uint16_t ScriptCompiler::addString(const std::string& value) {
+    // Одинаковые строки внутри программы храним один раз
+    for(size_t i = 0; i < program.strings.size(); i++) {
+        if(program.strings[i] == value) return static_cast<uint16_t>(i);
+    }
+    program.strings.push_back(value);
+    return static_cast<uint16_t>(program.strings.size() - 1);
+}
+
+bool ScriptCompiler::addExpression(const std::string& source, uint16_t& index, bool reportErrors) {
+    std::string error;
+    program.expressions.emplace_back();
+    index = static_cast<uint16_t>(program.expressions.size() - 1);
+    if(program.expressions.back().compile(source, error, variables)) return true;
+    if(reportErrors) {
+        std::cout << "Script " << program.name << ": bad expression \"" << source << "\": " << error << std::endl;
+    }
+    return false;
+}
+
+uint16_t ScriptCompiler::addText(const std::string& value, uint8_t& flag) {
+    if(value.find('{') == std::string::npos) return addString(value);
+    flag |= SCRIPT_FLAG_INTERPOLATE;
+    program.templates.emplace_back();
+    program.templates.back().compile(value, variables);
+    return static_cast<uint16_t>(program.templates.size() - 1);
+}
+
+void ScriptCompiler::compileCommand(const std::string& command, const json& parameter) {
+    ScriptInstruction ins;
+
+    if(command == "if") {
+        // JumpIfFalse -> then -> Jump в конец -> else
+        if(!parameter.contains("condition")) return;
+        ins.op = ScriptOp::JumpIfFalse;
+        // Условие с ошибкой ложно: ветка then не выполнится никогда
+        addExpression(parameter["condition"].get<std::string>(), ins.arg, true);
+        size_t branch = program.code.size();
+        program.code.push_back(ins);
+
+        if(parameter.contains("then")) {
+            compileBlock(parameter["then"]);
+        }
+        if(parameter.contains("else")) {
+            size_t skipElse = program.code.size();
+            program.code.push_back({ScriptOp::Jump});
+            program.code[branch].a = static_cast<int32_t>(program.code.size());
+            compileBlock(parameter["else"]);
+            program.code[skipElse].a = static_cast<int32_t>(program.code.size());
+        } else {
+            program.code[branch].a = static_cast<int32_t>(program.code.size());
+        }
+        return;
+    }
+
+    if(command == "parallel" || command == "race") {
+        // [[ветка], [ветка], ...]: каждая ветка выполняется своей сопрограммой и кончается End
+        if(!parameter.is_array()) throw std::runtime_error("list of branches expected");
+        ins.op = command == "parallel" ? ScriptOp::Parallel : ScriptOp::Race;
+        ins.a = static_cast<int32_t>(parameter.size());
+        size_t head = program.code.size();
+        program.code.push_back(ins);
+        for(size_t i = 0; i < parameter.size(); i++) {
+            program.code.push_back({ScriptOp::Jump});
+        }
+        for(size_t i = 0; i < parameter.size(); i++) {
+            program.code[head + 1 + i].a = static_cast<int32_t>(program.code.size());
+            compileBlock(parameter[i]);
+            program.code.push_back({});  // ScriptOp::End
+        }
+        program.code[head].b = static_cast<int32_t>(program.code.size());
+        return;
+    }
+
+    if(command == "showDialog" || command == "showVid") {
+        ins.op = command == "showDialog" ? ScriptOp::ShowDialog : ScriptOp::ShowVideo;
+        ins.arg = addText(parameter.get<std::string>(), ins.flag);
+    } else if(command == "showDebugMessage") {
+        ins.op = ScriptOp::DebugMessage;
+        ins.arg = parameter.is_string() ? addText(parameter.get<std::string>(), ins.flag) : addString(parameter.dump());
+    } else if(command == "wait" || command == "fadeIn" || command == "fadeOut") {
+        ins.op = command == "wait" ? ScriptOp::Wait : (command == "fadeIn" ? ScriptOp::FadeIn : ScriptOp::FadeOut);
+        ins.value = parameter.get<float>();
+    } else if(command == "playerMovement") {
+        ins.op = ScriptOp::PlayerMovement;
+        ins.flag = parameter.get<bool>() ? SCRIPT_FLAG_BOOL : 0;
+    } else if(command == "setVar") {
+        // ["name", "expression"]
+        if(!parameter.is_array() || parameter.size() != 2) throw std::runtime_error("[name, expression] expected");
+        ins.op = ScriptOp::SetVar;
+        ins.a = variables.resolve(parameter[0].get<std::string>());
+        std::string expression = parameter[1].get<std::string>();
+        uint16_t index = 0;
+        if(addExpression(expression, index, false)) {
+            ins.b = index;
+        } else {
+            // Не выражение ("Hello, {name}!") - присваиваем как текст
+            program.expressions.pop_back();
+            ins.flag = SCRIPT_FLAG_TEXT;
+            ins.b = addText(expression, ins.flag);
+        }
+    } else if(command == "setCollision") {
+        // [row, col, bool] или [row, col, "layer", bool]
+        if(!parameter.is_array() || (parameter.size() != 3 && parameter.size() != 4)) {
+            throw std::runtime_error("[row, col, (layer,) bool] expected");
+        }
+        CollisionLayer layer = CollisionLayer::Solid;
+        if(parameter.size() == 4 && !CollisionGrid::parseLayer(parameter[2].get<std::string>(), layer)) {
+            throw std::runtime_error("unknown collision layer " + parameter[2].dump());
+        }
+        ins.op = ScriptOp::SetCollision;
+        ins.a = parameter[0].get<int>();
+        ins.b = parameter[1].get<int>();
+        ins.arg = static_cast<uint16_t>(layer);
+        ins.flag = parameter.back().get<bool>() ? SCRIPT_FLAG_BOOL : 0;
+    } else if(command == "walkTo") {
+        if(!parameter.is_array() || parameter.size() != 2) throw std::runtime_error("[row, col] expected");
+        ins.op = ScriptOp::WalkTo;
+        ins.a = parameter[0].get<int>();
+        ins.b = parameter[1].get<int>();
+    } else if(command == "particles" || command == "particleBurst") {
+        // ["name", true/false] или ["name", count]
+        if(!parameter.is_array() || parameter.size() != 2) throw std::runtime_error("[name, value] expected");
+        ins.arg = addString(parameter[0].get<std::string>());
+        if(command == "particles") {
+            ins.op = ScriptOp::Particles;
+            ins.flag = parameter[1].get<bool>() ? SCRIPT_FLAG_BOOL : 0;
+        } else {
+            ins.op = ScriptOp::ParticleBurst;
+            ins.a = parameter[1].get<int>();
+        }
+    } else {
+        std::cout << "Script " << program.name << ": unknown command " << command << std::endl;
+        return;
+    }
+
+    program.code.push_back(ins);
+}
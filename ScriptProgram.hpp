@@ -0,0 +1,85 @@
+#ifndef ScriptProgram_hpp
+#define ScriptProgram_hpp
+
+#include "nlohmann/json.hpp"
+#include "ScriptExpression.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Коды инструкций скрипта сцены
+enum class ScriptOp : uint8_t {
+    End,            // Конец программы
+    Jump,           // a - адрес перехода
+    JumpIfFalse,    // arg - условие в пуле выражений, a - адрес перехода
+    ShowDialog,     // arg - имя группы диалогов (шаблон, если SCRIPT_FLAG_INTERPOLATE), b - индекс группы после линковки
+    DebugMessage,   // arg - текст (шаблон, если SCRIPT_FLAG_INTERPOLATE)
+    Wait,           // value - секунды
+    PlayerMovement, // flag & SCRIPT_FLAG_BOOL
+    FadeIn,         // value - длительность
+    FadeOut,        // value - длительность
+    SetVar,         // a - слот переменной, b - выражение (или строка/шаблон, если SCRIPT_FLAG_TEXT)
+    SetCollision,   // a - строка, b - столбец, arg - слой, flag & SCRIPT_FLAG_BOOL
+    WalkTo,         // a - строка, b - столбец
+    ShowVideo,      // arg - путь к видео (шаблон, если SCRIPT_FLAG_INTERPOLATE)
+    Particles,      // arg - имя эмиттера, b - индекс эмиттера после линковки, flag & SCRIPT_FLAG_BOOL
+    ParticleBurst,  // arg - имя эмиттера, b - индекс эмиттера после линковки, a - количество частиц
+    Parallel,       // a - число веток, b - адрес после блока; следом a инструкций Jump на начала веток
+    Race            // То же, но блок завершается первой закончившейся веткой, остальные снимаются
+};
+
+const size_t SCRIPT_OP_COUNT = static_cast<size_t>(ScriptOp::Race) + 1;
+
+// Имя команды для отладки и профиля (как в JSON-скриптах)
+const char* scriptOpName(ScriptOp op);
+
+const uint8_t SCRIPT_FLAG_BOOL = 1;         // Логический операнд команды
+const uint8_t SCRIPT_FLAG_INTERPOLATE = 2;  // В строке есть {переменные}: операнд - индекс в пуле шаблонов
+const uint8_t SCRIPT_FLAG_TEXT = 4;         // setVar присваивает текст, а не выражение
+
+// Инструкция фиксированного размера (16 байт) с типизированными операндами
+struct ScriptInstruction {
+    ScriptOp op = ScriptOp::End;
+    uint8_t flag = 0;
+    uint16_t arg = 0;   // Индекс строки (шаблона) в пуле программы или малое значение (слой коллизии)
+    int32_t a = 0;
+    int32_t b = 0;
+    float value = 0.0f;
+};
+
+// Скомпилированная группа скриптов: код и пулы строк, шаблонов и выражений, на которые ссылаются инструкции
+struct ScriptProgram {
+    std::string name;
+    std::vector<ScriptInstruction> code;
+    std::vector<std::string> strings;
+    std::vector<TextTemplate> templates;
+    std::vector<ScriptExpression> expressions;
+
+    bool empty() const { return code.empty(); }
+    const std::string& string(uint16_t index) const { return strings[index]; }
+};
+
+// Компиляция JSON-скриптов сцены ("ScriptGroups", "InitialScript") в байткод.
+// Выполняется один раз при загрузке сцены, ошибки в командах выводятся сразу.
+// Имена переменных разрешаются в слоты variables здесь же.
+class ScriptCompiler {
+public:
+    ScriptCompiler(ScriptProgram& program, VariableStore& variables) : program(program), variables(variables) {}
+
+    static void compile(const json& commands, const std::string& name, ScriptProgram& program, VariableStore& variables);
+
+private:
+    ScriptProgram& program;
+    VariableStore& variables;
+
+    void compileBlock(const json& commands);
+    void compileCommand(const std::string& command, const json& parameter);
+    uint16_t addString(const std::string& value);
+    bool addExpression(const std::string& source, uint16_t& index, bool reportErrors);
+    // Строка без {переменных} уходит в пул строк, с ними - в пул шаблонов (flag |= SCRIPT_FLAG_INTERPOLATE)
+    uint16_t addText(const std::string& value, uint8_t& flag);
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include "ScriptScheduler.hpp"
+#include "StateJournal.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+static double wallClock() {
+    using Clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
+
+bool ScriptScheduler::start(const ScriptProgram& program) {
+    if(program.empty()) return false;
+    int32_t id = spawn(program, 0, -1);
+    fibers[id].stats->count++;
+    ready.push_back(refTo(id));
+    version++;
+    return true;
+}
+
+bool ScriptScheduler::isRunning(const ScriptProgram& program) const {
+    for(const auto& fiber : fibers) {
+        if(fiber.program == &program && fiber.parent < 0) return true;
+    }
+    return false;
+}
+
+void ScriptScheduler::clear() {
+    fibers.clear();
+    freeFibers.clear();
+    activeCount = 0;
+    ready.clear();
+    running.clear();
+    for(auto& list : waiting) list.clear();
+    for(auto& bucket : wheel) bucket.clear();
+    version++;
+}
+
+int32_t ScriptScheduler::spawn(const ScriptProgram& program, uint32_t pc, int32_t parent) {
+    int32_t id;
+    if(!freeFibers.empty()) {
+        id = freeFibers.back();
+        freeFibers.pop_back();
+    } else {
+        id = static_cast<int32_t>(fibers.size());
+        fibers.emplace_back();
+    }
+    Fiber& fiber = fibers[id];
+    fiber.program = &program;
+    fiber.pc = pc;
+    fiber.parent = parent;
+    fiber.pendingChildren = 0;
+    fiber.race = false;
+    fiber.sleeping = false;
+    // Ветки parallel/race наследуют счетчики родителя
+    fiber.stats = parent >= 0 ? fibers[parent].stats : &programStats[program.name];
+    activeCount++;
+    return id;
+}
+
+bool ScriptScheduler::isCurrent(const FiberRef& ref) const {
+    const Fiber& fiber = fibers[ref.fiber];
+    return fiber.program && fiber.generation == ref.generation;
+}
+
+void ScriptScheduler::signal(ScriptEvent event) {
+    auto& list = waiting[static_cast<size_t>(event)];
+    if(list.empty()) return;
+    for(const auto& ref : list) {
+        if(isCurrent(ref)) ready.push_back(ref);
+    }
+    list.clear();
+    version++;
+}
+
+void ScriptScheduler::sleep(int32_t id, ScriptOp op) {
+    Fiber& fiber = fibers[id];
+    fiber.sleeping = true;
+    fiber.sleepOp = op;
+    fiber.sleepStart = time;
+}
+
+void ScriptScheduler::wake(Fiber& fiber) {
+    if(!fiber.sleeping) return;
+    fiber.sleeping = false;
+    const double blocked = time - fiber.sleepStart;
+    ScriptStats& op = opStats[static_cast<size_t>(fiber.sleepOp)];
+    op.blockedTime += blocked;
+    op.blockedCount++;
+    fiber.stats->blockedTime += blocked;
+    fiber.stats->blockedCount++;
+}
+
+void ScriptScheduler::addTimer(int32_t id, float seconds) {
+    // Отсчет от начала тика: тик, на котором начался wait, тоже засчитывается, как раньше
+    placeTimer({tickStart + seconds, refTo(id)});
+}
+
+void ScriptScheduler::placeTimer(const Timer& timer) {
+    const uint64_t tick = std::max(static_cast<uint64_t>(timer.deadline / TIMER_RESOLUTION), nextTick);
+    wheel[tick & (WHEEL_SIZE - 1)].push_back(timer);
+}
+
+void ScriptScheduler::advanceTimers() {
+    // Погрешность накопления float-шагов не должна откладывать таймер на лишний тик
+    const double now = time + 1e-6;
+    const uint64_t target = static_cast<uint64_t>(now / TIMER_RESOLUTION);
+    for(uint64_t tick = nextTick; tick <= target; tick++) {
+        // В ячейке лежат и таймеры следующих оборотов колеса, и таймеры конца текущей ячейки - они остаются
+        auto& bucket = wheel[tick & (WHEEL_SIZE - 1)];
+        for(size_t i = 0; i < bucket.size();) {
+            if(bucket[i].deadline > now) {
+                i++;
+                continue;
+            }
+            if(isCurrent(bucket[i].ref)) ready.push_back(bucket[i].ref);
+            bucket[i] = bucket.back();
+            bucket.pop_back();
+        }
+    }
+    // Текущая ячейка пройдена не до конца, следующий update посмотрит ее снова
+    nextTick = target;
+}
+
+void ScriptScheduler::update(float deltaTime, const VariableStore& variables) {
+    tickStart = time;
+    time += deltaTime;
+    advanceTimers();
+
+    // Проснувшиеся во время прохода (события из исполнителя, завершение веток) выполняются в этом же тике
+    while(!ready.empty()) {
+        running.swap(ready);
+        for(const auto& ref : running) {
+            if(isCurrent(ref)) run(ref.fiber, variables);
+        }
+        running.clear();
+    }
+}
+
+void ScriptScheduler::run(int32_t id, const VariableStore& variables) {
+    version++;
+    wake(fibers[id]);
+    ScriptStats* stats = fibers[id].stats;
+    const double sliceStart = wallClock();
+    runSlice(id, variables);
+    stats->runTime += wallClock() - sliceStart;
+}
+
+void ScriptScheduler::runSlice(int32_t id, const VariableStore& variables) {
+    // Мгновенные инструкции выполняются подряд, на длительной сопрограмма засыпает
+    while(true) {
+        Fiber& fiber = fibers[id];
+        const ScriptProgram& program = *fiber.program;
+        const ScriptInstruction& ins = program.code[fiber.pc];
+        opStats[static_cast<size_t>(ins.op)].count++;
+
+        switch(ins.op) {
+        case ScriptOp::End:
+            finish(id);
+            return;
+        case ScriptOp::Jump:
+            fiber.pc = ins.a;
+            continue;
+        case ScriptOp::JumpIfFalse:
+            fiber.pc = program.expressions[ins.arg].evaluateCondition(variables) ? fiber.pc + 1 : ins.a;
+            continue;
+        case ScriptOp::Parallel:
+        case ScriptOp::Race: {
+            // За инструкцией идет таблица из a переходов на начала веток
+            const uint32_t table = fiber.pc + 1;
+            const uint16_t branches = static_cast<uint16_t>(ins.a);
+            fiber.pc = ins.b;
+            fiber.race = ins.op == ScriptOp::Race;
+            fiber.pendingChildren = ins.op == ScriptOp::Race ? std::min<uint16_t>(branches, 1) : branches;
+            if(branches == 0) continue;
+            sleep(id, ins.op);
+            for(uint16_t i = 0; i < branches; i++) {
+                // spawn может переразместить fibers, поэтому fiber дальше не используем
+                ready.push_back(refTo(spawn(program, program.code[table + i].a, id)));
+            }
+            return;
+        }
+        case ScriptOp::Wait:
+            fiber.pc++;
+            if(ins.value <= 0.0f) continue;
+            addTimer(id, ins.value);
+            sleep(id, ins.op);
+            return;
+        default:
+            break;
+        }
+
+        fiber.pc++;
+        const ScriptOp op = ins.op;
+        const double start = wallClock();
+        ScriptEvent event = executor ? executor(program, ins) : ScriptEvent::None;
+        opStats[static_cast<size_t>(op)].runTime += wallClock() - start;
+        // Исполнитель мог запустить новые сопрограммы или остановить все (смена сцены)
+        if(static_cast<size_t>(id) >= fibers.size() || fibers[id].program != &program) return;
+        if(event == ScriptEvent::None) continue;
+        waiting[static_cast<size_t>(event)].push_back(refTo(id));
+        sleep(id, op);
+        return;
+    }
+}
+
+void ScriptScheduler::finish(int32_t id) {
+    const int32_t parent = fibers[id].parent;
+    kill(id);
+    if(parent < 0) return;
+
+    Fiber& owner = fibers[parent];
+    if(owner.race) {
+        // Первая завершившаяся ветка снимает остальные
+        for(size_t i = 0; i < fibers.size(); i++) {
+            if(fibers[i].program && fibers[i].parent == parent) kill(static_cast<int32_t>(i));
+        }
+        owner.pendingChildren = 0;
+    } else {
+        owner.pendingChildren--;
+    }
+    if(owner.pendingChildren == 0) {
+        owner.race = false;
+        ready.push_back(refTo(parent));
+    }
+}
+
+void ScriptScheduler::kill(int32_t id) {
+    // Вместе с сопрограммой снимаются ее ветки; их записи в таймерах и списках ожидания устаревают
+    for(size_t i = 0; i < fibers.size(); i++) {
+        if(fibers[i].program && fibers[i].parent == id) kill(static_cast<int32_t>(i));
+    }
+    Fiber& fiber = fibers[id];
+    wake(fiber);  // Снятая ветка race тоже успела подождать
+    fiber.program = nullptr;
+    fiber.parent = -1;
+    fiber.generation++;
+    freeFibers.push_back(id);
+    activeCount--;
+}
+
+template<typename T>
+static void putVector(std::vector<uint8_t>& out, const std::vector<T>& values) {
+    journalPut(out, static_cast<uint32_t>(values.size()));
+    const auto* bytes = reinterpret_cast<const uint8_t*>(values.data());
+    out.insert(out.end(), bytes, bytes + values.size() * sizeof(T));
+}
+
+template<typename T>
+static void getVector(JournalReader& reader, std::vector<T>& values) {
+    values.resize(reader.get<uint32_t>());
+    std::memcpy(values.data(), reader.data + reader.pos, values.size() * sizeof(T));
+    reader.pos += values.size() * sizeof(T);
+}
+
+void ScriptScheduler::saveState(std::vector<uint8_t>& out) const {
+    putVector(out, fibers);
+    putVector(out, freeFibers);
+    journalPut(out, static_cast<uint64_t>(activeCount));
+    putVector(out, ready);
+    for(const auto& list : waiting) putVector(out, list);
+    // Колесо сохраняется списком таймеров, ячейки восстановятся по срокам
+    uint32_t timerCount = 0;
+    for(const auto& bucket : wheel) timerCount += static_cast<uint32_t>(bucket.size());
+    journalPut(out, timerCount);
+    for(const auto& bucket : wheel) {
+        for(const auto& timer : bucket) journalPut(out, timer);
+    }
+}
+
+void ScriptScheduler::restoreState(const uint8_t* data, size_t size) {
+    JournalReader reader{data, size};
+    getVector(reader, fibers);
+    getVector(reader, freeFibers);
+    activeCount = static_cast<size_t>(reader.get<uint64_t>());
+    getVector(reader, ready);
+    running.clear();
+    for(auto& list : waiting) getVector(reader, list);
+    for(auto& bucket : wheel) bucket.clear();
+    const uint32_t timerCount = reader.get<uint32_t>();
+    for(uint32_t i = 0; i < timerCount; i++) {
+        placeTimer(reader.get<Timer>());
+    }
+    version++;
+}
+
+void ScriptScheduler::rewindTime(double seconds) {
+    time = std::max(0.0, time - seconds);
+    tickStart = time;
+    nextTick = static_cast<uint64_t>((time + 1e-6) / TIMER_RESOLUTION);
+    // Ячейки таймеров, прижатых к старому nextTick, пересчитываются
+    std::vector<Timer> timers;
+    for(auto& bucket : wheel) {
+        timers.insert(timers.end(), bucket.begin(), bucket.end());
+        bucket.clear();
+    }
+    for(const auto& timer : timers) {
+        placeTimer(timer);
+    }
+}
+
+void ScriptScheduler::printProfile(std::ostream& out) const {
+    auto row = [&out](const std::string& name, const ScriptStats& stats) {
+        out << std::left << std::setw(24) << name << std::right
+            << std::setw(8) << stats.count
+            << std::setw(12) << std::fixed << std::setprecision(3) << stats.runTime * 1000.0
+            << std::setw(10) << stats.blockedCount
+            << std::setw(12) << std::setprecision(2) << stats.blockedTime << '\n';
+    };
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+
+    out << "\n=== Script Profile ===\n";
+    out << std::left << std::setw(24) << "group" << std::right << std::setw(8) << "runs"
+        << std::setw(12) << "run ms" << std::setw(10) << "waits" << std::setw(12) << "blocked s" << '\n';
+    for(const auto& [name, stats] : programStats) row(name, stats);
+    out << std::left << std::setw(24) << "command" << std::right << std::setw(8) << "calls"
+        << std::setw(12) << "exec ms" << std::setw(10) << "waits" << std::setw(12) << "blocked s" << '\n';
+    for(size_t op = 0; op < SCRIPT_OP_COUNT; op++) {
+        if(opStats[op].count > 0) row(scriptOpName(static_cast<ScriptOp>(op)), opStats[op]);
+    }
+    out << "======================\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+json ScriptScheduler::profileJson() const {
+    auto toJson = [](const ScriptStats& stats) {
+        return json{{"count", stats.count}, {"runTime", stats.runTime},
+                    {"blockedCount", stats.blockedCount}, {"blockedTime", stats.blockedTime}};
+    };
+    json groups = json::object();
+    for(const auto& [name, stats] : programStats) groups[name] = toJson(stats);
+    json commands = json::object();
+    for(size_t op = 0; op < SCRIPT_OP_COUNT; op++) {
+        if(opStats[op].count > 0) commands[scriptOpName(static_cast<ScriptOp>(op))] = toJson(opStats[op]);
+    }
+    return json{{"groups", groups}, {"commands", commands}};
+}
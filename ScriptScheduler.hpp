@@ -0,0 +1,128 @@
+#ifndef ScriptScheduler_hpp
+#define ScriptScheduler_hpp
+
+#include "ScriptProgram.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// Событие, которого ждет длительная инструкция
+enum class ScriptEvent : uint8_t {
+    None,          // Инструкция выполнилась сразу
+    DialogClosed,
+    FadeEnd,
+    VideoEnd,
+    WalkEnd,
+    Count
+};
+
+// Счетчики профиля для группы скриптов или типа команды
+struct ScriptStats {
+    uint64_t count = 0;        // Запуски группы / выполнения команды
+    double runTime = 0.0;      // Реальное время выполнения, с
+    double blockedTime = 0.0;  // Игровое время ожидания (wait, события, ветки parallel/race), с
+    uint64_t blockedCount = 0;
+};
+
+// Планировщик скриптов сцены. Каждый запущенный скрипт - легкая сопрограмма (fiber):
+// программа, счетчик команд и ссылка на родителя, без собственного стека.
+// Сопрограмма выполняет мгновенные инструкции подряд и засыпает на длительной:
+// wait - в колесе таймеров, диалог/затемнение/видео/ходьба - в списке ожидания события.
+// Спящие сопрограммы не опрашиваются каждый кадр, их будит signal() или таймер.
+// parallel/race запускают ветки дочерними сопрограммами, родитель ждет всех или первую.
+class ScriptScheduler {
+public:
+    // Выполнение прикладной инструкции (диалог, переменные, частицы...), возвращает событие ожидания
+    using Executor = std::function<ScriptEvent(const ScriptProgram&, const ScriptInstruction&)>;
+
+    void setExecutor(Executor executor) { this->executor = std::move(executor); }
+
+    // Запуск программы новой сопрограммой; false, если программа пустая
+    bool start(const ScriptProgram& program);
+    // Программа уже выполняется верхнеуровневой сопрограммой
+    bool isRunning(const ScriptProgram& program) const;
+    bool empty() const { return activeCount == 0; }
+    // Остановить все; программы, на которые ссылаются сопрограммы, можно удалять
+    void clear();
+
+    // Будит все сопрограммы, ждущие события
+    void signal(ScriptEvent event);
+    // Продвигает время и выполняет готовые сопрограммы
+    void update(float deltaTime, const VariableStore& variables);
+
+    // Профиль копится с запуска игры, смена сцены его не сбрасывает.
+    // Группы - по имени программы, команды - по типу инструкции
+    void printProfile(std::ostream& out) const;
+    json profileJson() const;
+
+    // Журнал отката. Версия меняется, когда сопрограммы выполняются, запускаются или просыпаются.
+    // Состояние - сопрограммы, очереди и таймеры, без времени и профиля; программы должны остаться те же
+    uint64_t getVersion() const { return version; }
+    void saveState(std::vector<uint8_t>& out) const;
+    void restoreState(const uint8_t* data, size_t size);
+    // Сдвигает время назад; таймеры сохраняют свои сроки
+    void rewindTime(double seconds);
+
+private:
+    static constexpr double TIMER_RESOLUTION = 0.01;  // Секунд на ячейку колеса
+    static constexpr uint32_t WHEEL_SIZE = 256;       // Степень двойки; полный оборот - 2.56 с
+
+    struct Fiber {
+        const ScriptProgram* program = nullptr;  // nullptr - слот свободен
+        uint32_t pc = 0;
+        uint32_t generation = 0;  // Меняется при завершении, старые записи таймеров и событий игнорируются
+        int32_t parent = -1;
+        uint16_t pendingChildren = 0;
+        bool race = false;        // Родитель ждет первую завершившуюся ветку, а не все
+        bool sleeping = false;
+        ScriptOp sleepOp = ScriptOp::End;  // Инструкция, на которой сопрограмма уснула
+        double sleepStart = 0.0;
+        ScriptStats* stats = nullptr;       // Счетчики группы, узел unordered_map не перемещается
+    };
+
+    // Ссылка на сопрограмму в таймере или списке ожидания
+    struct FiberRef {
+        int32_t fiber;
+        uint32_t generation;
+    };
+
+    struct Timer {
+        double deadline;  // Время срабатывания; ячейка колеса - floor(deadline / TIMER_RESOLUTION)
+        FiberRef ref;
+    };
+
+    Executor executor;
+    std::vector<Fiber> fibers;
+    std::vector<int32_t> freeFibers;
+    size_t activeCount = 0;
+
+    std::vector<FiberRef> ready;
+    std::vector<FiberRef> running;  // Очередь текущего прохода update
+    std::array<std::vector<FiberRef>, static_cast<size_t>(ScriptEvent::Count)> waiting;
+    std::array<std::vector<Timer>, WHEEL_SIZE> wheel;
+    double time = 0.0;
+    double tickStart = 0.0;  // time до текущего update
+    uint64_t nextTick = 0;  // Первая ячейка, которую колесо еще не прошло целиком
+    uint64_t version = 0;
+
+    std::unordered_map<std::string, ScriptStats> programStats;
+    std::array<ScriptStats, SCRIPT_OP_COUNT> opStats;
+
+    int32_t spawn(const ScriptProgram& program, uint32_t pc, int32_t parent);
+    void run(int32_t id, const VariableStore& variables);
+    void runSlice(int32_t id, const VariableStore& variables);
+    void finish(int32_t id);
+    void kill(int32_t id);
+    void sleep(int32_t id, ScriptOp op);
+    void wake(Fiber& fiber);
+    void advanceTimers();
+    void addTimer(int32_t id, float seconds);
+    void placeTimer(const Timer& timer);
+    bool isCurrent(const FiberRef& ref) const;
+    FiberRef refTo(int32_t id) const { return {id, fibers[id].generation}; }
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "ScriptedInput.hpp"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using json = nlohmann::json;
+
+ScriptedInput::ScriptedInput()
+    : nextEntry(0),
+      scripted(false),
+      rngState(1),
+      nextRandomChange(0),
+      currentX(0.0f),
+      currentY(0.0f)
+{
+}
+
+bool ScriptedInput::load(const std::string& path) {
+    std::ifstream file(path);
+    if(!file.is_open()) {
+        std::cout << "Failed to open input script: " << path << std::endl;
+        return false;
+    }
+
+    try {
+        json data;
+        file >> data;
+
+        entries.clear();
+        for(const auto& item : data) {
+            Entry entry{};
+            entry.tick = item.value("tick", 0ull);
+            if(item.contains("move")) {
+                entry.hasMove = true;
+                entry.moveX = item["move"][0].get<float>();
+                entry.moveY = item["move"][1].get<float>();
+            }
+            if(item.contains("action")) {
+                std::string action = item["action"];
+                entry.hasAction = true;
+                if(action == "use") entry.action = InputAction::Use;
+                else if(action == "printCell") entry.action = InputAction::PrintPlayerCell;
+                else if(action == "testDialog") entry.action = InputAction::ToggleTestDialog;
+                else if(action == "printVars") entry.action = InputAction::PrintVariables;
+                else if(action == "printProfile") entry.action = InputAction::PrintScriptProfile;
+                else if(action == "printAssets") entry.action = InputAction::PrintAssetStats;
+                else if(action == "rewind") {
+                    entry.action = InputAction::Rewind;
+                    entry.data1 = static_cast<int>(item.value("seconds", 5.0) * 1000.0);
+                }
+                else {
+                    std::cout << "Unknown input action: " << action << std::endl;
+                    entry.hasAction = false;
+                }
+            }
+            entries.push_back(entry);
+        }
+        std::stable_sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.tick < b.tick; });
+    } catch (const std::exception& e) {
+        std::cout << "Error parsing input script: " << e.what() << std::endl;
+        return false;
+    }
+
+    scripted = true;
+    nextEntry = 0;
+    return true;
+}
+
+void ScriptedInput::setSeed(Uint32 seed) {
+    rngState = seed ? seed : 1;
+}
+
+Uint32 ScriptedInput::nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+void ScriptedInput::poll(Uint64 tick, float& moveX, float& moveY, std::vector<InputEvent>& events) {
+    if(scripted) {
+        while(nextEntry < entries.size() && entries[nextEntry].tick <= tick) {
+            const Entry& entry = entries[nextEntry++];
+            if(entry.hasMove) {
+                currentX = entry.moveX;
+                currentY = entry.moveY;
+            }
+            if(entry.hasAction) {
+                events.push_back({entry.action, entry.data1, 0});
+            }
+        }
+    } else if(tick >= nextRandomChange) {
+        // Случайное блуждание: новое направление раз в 10-50 тиков, иногда нажатие "use"
+        static const float directions[9][2] = {
+            {0, 0}, {1, 0}, {-1, 0}, {0, 1}, {0, -1},
+            {0.707107f, 0.707107f}, {-0.707107f, 0.707107f},
+            {0.707107f, -0.707107f}, {-0.707107f, -0.707107f}
+        };
+        const float* direction = directions[nextRandom() % 9];
+        currentX = direction[0];
+        currentY = direction[1];
+        if(nextRandom() % 4 == 0) {
+            events.push_back({InputAction::Use, 0, 0});
+        }
+        nextRandomChange = tick + 10 + nextRandom() % 41;
+    }
+
+    moveX = currentX;
+    moveY = currentY;
+}
@@ -0,0 +1,43 @@
+#ifndef ScriptedInput_hpp
+#define ScriptedInput_hpp
+
+#include "InputEvent.hpp"
+#include "SDL2/SDL.h"
+#include <string>
+#include <vector>
+
+// Источник ввода для headless-прогонов.
+// Либо читает сценарий из JSON: [{"tick": 0, "move": [1, 0]}, {"tick": 40, "action": "use"}],
+// либо, если сценария нет, генерирует случайные блуждания с фиксированным seed.
+class ScriptedInput {
+public:
+    ScriptedInput();
+
+    bool load(const std::string& path);
+    void setSeed(Uint32 seed);
+    // Ввод для тика tick: движение держится до следующей смены, действия добавляются в events
+    void poll(Uint64 tick, float& moveX, float& moveY, std::vector<InputEvent>& events);
+
+private:
+    struct Entry {
+        Uint64 tick;
+        bool hasMove;
+        float moveX;
+        float moveY;
+        bool hasAction;
+        InputAction action;
+        int data1;  // Параметр действия (миллисекунды для rewind)
+    };
+
+    std::vector<Entry> entries;
+    size_t nextEntry;
+    bool scripted;
+    Uint32 rngState;
+    Uint64 nextRandomChange;
+    float currentX;
+    float currentY;
+
+    Uint32 nextRandom();
+};
+
+#endif
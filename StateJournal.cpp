@@ -0,0 +1,70 @@
+#include "StateJournal.hpp"
+#include <algorithm>
+
+void StateJournal::setBudget(size_t bytes) {
+    ring.assign(bytes, 0);
+    ring.shrink_to_fit();
+    head = 0;
+    used = 0;
+    frames = 0;
+}
+
+void StateJournal::clear(uint64_t tick) {
+    head = 0;
+    used = 0;
+    frames = 0;
+    floorTick = tick;
+}
+
+void StateJournal::commit(uint64_t tick, const std::vector<uint8_t>& records) {
+    if(ring.empty() || records.empty()) return;
+
+    const uint32_t size = static_cast<uint32_t>(records.size());
+    const size_t frameSize = FRAME_OVERHEAD + size;
+    if(frameSize > ring.size()) {
+        // Кадр больше всего бюджета - история до него теряется целиком
+        clear(tick);
+        return;
+    }
+    while(used + frameSize > ring.size()) {
+        evictOldest();
+    }
+
+    size_t pos = head + used;
+    write(pos, &tick, sizeof(tick));
+    pos += sizeof(tick);
+    write(pos, &size, sizeof(size));
+    pos += sizeof(size);
+    write(pos, records.data(), size);
+    pos += size;
+    write(pos, &size, sizeof(size));
+    used += frameSize;
+    frames++;
+}
+
+void StateJournal::evictOldest() {
+    uint64_t tick;
+    uint32_t size;
+    read(head, &tick, sizeof(tick));
+    read(head + sizeof(tick), &size, sizeof(size));
+    const size_t frameSize = FRAME_OVERHEAD + size;
+    head = (head + frameSize) % ring.size();
+    used -= frameSize;
+    frames--;
+    // Без отмены этого кадра состояние известно только начиная с его тика
+    floorTick = tick;
+}
+
+void StateJournal::write(size_t pos, const void* data, size_t size) {
+    pos %= ring.size();
+    const size_t first = std::min(size, ring.size() - pos);
+    std::memcpy(ring.data() + pos, data, first);
+    std::memcpy(ring.data(), static_cast<const uint8_t*>(data) + first, size - first);
+}
+
+void StateJournal::read(size_t pos, void* data, size_t size) const {
+    pos %= ring.size();
+    const size_t first = std::min(size, ring.size() - pos);
+    std::memcpy(data, ring.data() + pos, first);
+    std::memcpy(static_cast<uint8_t*>(data) + first, ring.data(), size - first);
+}
@@ -0,0 +1,99 @@
+#ifndef StateJournal_hpp
+#define StateJournal_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Журнал отката сцены: кольцевой буфер кадров с записями отмены - старыми значениями того,
+// что изменилось за тик. Кадр пишется только на тиках с изменениями, поэтому память растет
+// с числом изменений, а не с числом тиков. При нехватке бюджета вытесняются самые старые кадры.
+// Кадр в буфере: u64 тик, u32 размер, записи, u32 размер (для обхода с конца).
+class StateJournal {
+public:
+    // Бюджет в байтах; 0 - журнал выключен
+    void setBudget(size_t bytes);
+    bool isEnabled() const { return !ring.empty(); }
+    // Забыть историю: откатиться раньше tick больше нельзя
+    void clear(uint64_t tick);
+    // Записи отмены тика tick; пустой кадр не пишется
+    void commit(uint64_t tick, const std::vector<uint8_t>& records);
+
+    // Снимает кадры новее targetTick, от новых к старым, и отдает их записи undo(data, size).
+    // Возвращает тик, до которого удалось откатиться: вытесненную историю не вернуть
+    template<typename Undo>
+    uint64_t rewind(uint64_t targetTick, Undo undo) {
+        if(targetTick < floorTick) targetTick = floorTick;
+        while(used > 0) {
+            const size_t end = head + used;
+            uint32_t size;
+            read(end - sizeof(size), &size, sizeof(size));
+            const size_t frameStart = end - FRAME_OVERHEAD - size;
+            uint64_t tick;
+            read(frameStart, &tick, sizeof(tick));
+            if(tick <= targetTick) break;
+
+            scratch.resize(size);
+            read(frameStart + sizeof(tick) + sizeof(size), scratch.data(), size);
+            used -= FRAME_OVERHEAD + size;
+            frames--;
+            undo(scratch.data(), scratch.size());
+        }
+        return targetTick;
+    }
+
+    size_t usedBytes() const { return used; }
+    size_t frameCount() const { return frames; }
+
+private:
+    static constexpr size_t FRAME_OVERHEAD = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+    std::vector<uint8_t> ring;
+    size_t head = 0;   // Начало самого старого кадра
+    size_t used = 0;
+    size_t frames = 0;
+    uint64_t floorTick = 0;  // Состояние раньше этого тика потеряно
+    std::vector<uint8_t> scratch;  // Кадр, который мог переходить через конец кольца
+
+    void write(size_t pos, const void* data, size_t size);
+    void read(size_t pos, void* data, size_t size) const;
+    void evictOldest();
+};
+
+// Запись и чтение полей записей журнала. Журнал живет в памяти процесса, поэтому значения копируются как есть
+template<typename T>
+void journalPut(std::vector<uint8_t>& out, const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "journal values are copied bytewise");
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+inline void journalPutString(std::vector<uint8_t>& out, const std::string& value) {
+    journalPut(out, static_cast<uint32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+struct JournalReader {
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+
+    template<typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string getString() {
+        const uint32_t length = get<uint32_t>();
+        std::string value(reinterpret_cast<const char*>(data + pos), length);
+        pos += length;
+        return value;
+    }
+};
+
+#endif
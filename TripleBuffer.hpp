@@ -0,0 +1,45 @@
+#ifndef TripleBuffer_hpp
+#define TripleBuffer_hpp
+
+#include <atomic>
+
+// Тройной буфер без блокировок для передачи данных между двумя потоками.
+// Писатель всегда пишет в свой буфер и публикует его обменом со средним,
+// читатель забирает средний буфер, только если там появились новые данные.
+// Ни одна из сторон никогда не ждет другую.
+template<typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle(1), writeIndex(0), readIndex(2) {}
+
+    // Поток-писатель
+    T& writeBuffer() { return buffers[writeIndex]; }
+
+    void publish() {
+        int previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+
+    // Поток-читатель: возвращает true, если буфер для чтения обновился
+    bool acquire() {
+        if(!(middle.load(std::memory_order_acquire) & FRESH_BIT)) {
+            return false;
+        }
+        int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& readBuffer() const { return buffers[readIndex]; }
+
+private:
+    static const int INDEX_MASK = 0x3;
+    static const int FRESH_BIT = 0x4;
+
+    T buffers[3];
+    std::atomic<int> middle;
+    int writeIndex;  // Принадлежит писателю
+    int readIndex;   // Принадлежит читателю
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "VariableStore.hpp"
+
+int VariableStore::resolve(const std::string& name) {
+    auto it = slotByName.find(name);
+    if(it != slotByName.end()) return it->second;
+
+    int slot = static_cast<int>(slots.size());
+    slots.emplace_back();
+    names.push_back(name);
+    slotByName.emplace(name, slot);
+    return slot;
+}
+
+int VariableStore::find(const std::string& name) const {
+    auto it = slotByName.find(name);
+    return it != slotByName.end() ? it->second : -1;
+}
+
+void VariableStore::setBool(int slot, bool value) {
+    slots[slot].type = Type::Bool;
+    slots[slot].boolValue = value;
+}
+
+void VariableStore::setInt(int slot, int value) {
+    slots[slot].type = Type::Int;
+    slots[slot].intValue = value;
+}
+
+void VariableStore::setFloat(int slot, float value) {
+    slots[slot].type = Type::Float;
+    slots[slot].floatValue = value;
+}
+
+void VariableStore::setString(int slot, const std::string& value) {
+    Slot& s = slots[slot];
+    if(s.stringIndex < 0) {
+        // value может ссылаться на строку из этой же таблицы, поэтому копируем до push_back
+        std::string copy = value;
+        s.stringIndex = static_cast<int32_t>(strings.size());
+        strings.push_back(std::move(copy));
+    } else {
+        strings[s.stringIndex] = value;
+    }
+    s.type = Type::String;
+}
+
+void VariableStore::set(int slot, const ScriptVarValue& value) {
+    if(const bool* b = std::get_if<bool>(&value)) setBool(slot, *b);
+    else if(const int* i = std::get_if<int>(&value)) setInt(slot, *i);
+    else if(const float* f = std::get_if<float>(&value)) setFloat(slot, *f);
+    else setString(slot, std::get<std::string>(value));
+}
+
+ScriptVarValue VariableStore::get(int slot) const {
+    const Slot& s = slots[slot];
+    switch(s.type) {
+    case Type::Int: return s.intValue;
+    case Type::Float: return s.floatValue;
+    case Type::String: return strings[s.stringIndex];
+    case Type::Bool: return s.boolValue;
+    default: return false;
+    }
+}
+
+bool VariableStore::get(const std::string& name, ScriptVarValue& value) const {
+    int slot = find(name);
+    if(slot < 0 || !isDefined(slot)) return false;
+    value = get(slot);
+    return true;
+}
+
+void VariableStore::appendText(int slot, std::string& out) const {
+    const Slot& s = slots[slot];
+    switch(s.type) {
+    case Type::Bool: out += s.boolValue ? "true" : "false"; break;
+    case Type::Int: out += std::to_string(s.intValue); break;
+    case Type::Float: out += std::to_string(s.floatValue); break;
+    case Type::String: out += strings[s.stringIndex]; break;
+    default: break;
+    }
+}
+
+json VariableStore::toJson() const {
+    json values = json::object();
+    forEachDefined([&](const std::string& name, int slot) {
+        std::visit([&](const auto& value) { values[name] = value; }, get(slot));
+    });
+    return values;
+}
+
+void VariableStore::loadJson(const json& values) {
+    for(auto it = values.begin(); it != values.end(); ++it) {
+        const json& value = it.value();
+        if(value.is_boolean()) set(it.key(), value.get<bool>());
+        else if(value.is_number_integer()) set(it.key(), value.get<int>());
+        else if(value.is_number_float()) set(it.key(), value.get<float>());
+        else if(value.is_string()) set(it.key(), value.get<std::string>());
+        else set(it.key(), false);
+    }
+}
+
+void TextTemplate::compile(const std::string& text, VariableStore& variables) {
+    parts.clear();
+    std::string literal;
+    size_t pos = 0;
+    while(pos < text.size()) {
+        size_t open = text.find('{', pos);
+        size_t close = open == std::string::npos ? std::string::npos : text.find('}', open);
+        if(close == std::string::npos) {
+            literal += text.substr(pos);
+            break;
+        }
+        literal += text.substr(pos, open - pos);
+        parts.push_back({literal, variables.resolve(text.substr(open + 1, close - open - 1))});
+        literal.clear();
+        pos = close + 1;
+    }
+    if(!literal.empty() || parts.empty()) {
+        parts.push_back({literal, -1});
+    }
+}
+
+void TextTemplate::format(const VariableStore& variables, std::string& out) const {
+    out.clear();
+    for(const auto& part : parts) {
+        out += part.text;
+        if(part.slot < 0) continue;
+        if(variables.isDefined(part.slot)) {
+            variables.appendText(part.slot, out);
+        } else {
+            out += '{';
+            out += variables.getName(part.slot);
+            out += '}';
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef VariableStore_hpp
+#define VariableStore_hpp
+
+#include "nlohmann/json.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Значение глобальной переменной сцены
+using ScriptVarValue = std::variant<bool, int, float, std::string>;
+
+// Глобальные переменные по слотам.
+// Имена превращаются в номера слотов при загрузке скриптов, дальше чтение и запись - индекс в массиве.
+// Числа и bool лежат прямо в слоте, строки - в отдельной таблице, слот хранит номер строки.
+// Слоты не удаляются, поэтому номера, выданные скриптам, остаются действительными между сценами.
+class VariableStore {
+public:
+    enum class Type : uint8_t { Undefined, Bool, Int, Float, String };
+
+    // Слот по имени; создается неопределенным, если переменной еще нет
+    int resolve(const std::string& name);
+    // -1, если такой переменной нет
+    int find(const std::string& name) const;
+
+    size_t size() const { return slots.size(); }
+    const std::string& getName(int slot) const { return names[slot]; }
+    Type getType(int slot) const { return slots[slot].type; }
+    bool isDefined(int slot) const { return slots[slot].type != Type::Undefined; }
+
+    bool getBool(int slot) const { return slots[slot].boolValue; }
+    int getInt(int slot) const { return slots[slot].intValue; }
+    float getFloat(int slot) const { return slots[slot].floatValue; }
+    const std::string& getString(int slot) const { return strings[slots[slot].stringIndex]; }
+
+    void setBool(int slot, bool value);
+    void setInt(int slot, int value);
+    void setFloat(int slot, float value);
+    void setString(int slot, const std::string& value);
+    void set(int slot, const ScriptVarValue& value);
+    // Слот снова неопределен (откат журнала к моменту до первого присваивания)
+    void unset(int slot) { slots[slot].type = Type::Undefined; }
+    ScriptVarValue get(int slot) const;
+
+    // Доступ по имени - для отладки, сохранения и переменных, созданных во время игры
+    void set(const std::string& name, const ScriptVarValue& value) { set(resolve(name), value); }
+    bool get(const std::string& name, ScriptVarValue& value) const;
+
+    // Текст значения для подстановки {name}
+    void appendText(int slot, std::string& out) const;
+
+    // Сохранение и загрузка определенных переменных как {"name": value}
+    json toJson() const;
+    void loadJson(const json& values);
+
+    template<typename Callback>
+    void forEachDefined(Callback callback) const {
+        for(size_t slot = 0; slot < slots.size(); slot++) {
+            if(slots[slot].type != Type::Undefined) callback(names[slot], static_cast<int>(slot));
+        }
+    }
+
+private:
+    struct Slot {
+        Type type = Type::Undefined;
+        bool boolValue = false;
+        int intValue = 0;
+        float floatValue = 0.0f;
+        int32_t stringIndex = -1;  // Строка в strings, закрепляется за слотом при первом присваивании строки
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::string> names;
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, int> slotByName;
+};
+
+// Обратный индекс "слот переменной -> записи, которые его читают" (привязки коллизий, наблюдатели).
+// Записи слота slot лежат в entries[start[slot] .. start[slot + 1]), строится один раз при загрузке
+class VariableDependents {
+public:
+    // readsOf(i) - слоты, которые читает запись i, без повторов
+    template<typename ReadsOf>
+    void build(size_t slotCount, size_t entryCount, ReadsOf readsOf) {
+        start.assign(slotCount + 1, 0);
+        for(size_t i = 0; i < entryCount; i++) {
+            for(int slot : readsOf(i)) start[slot + 1]++;
+        }
+        for(size_t slot = 0; slot < slotCount; slot++) start[slot + 1] += start[slot];
+        entries.assign(start[slotCount], 0);
+        std::vector<int> fill(start.begin(), start.end() - 1);
+        for(size_t i = 0; i < entryCount; i++) {
+            for(int slot : readsOf(i)) entries[fill[slot]++] = static_cast<int>(i);
+        }
+    }
+
+    void clear() {
+        start.clear();
+        entries.clear();
+    }
+
+    // Слоты, созданные после build, никто из записей не читает
+    template<typename Callback>
+    void forEach(int slot, Callback callback) const {
+        if(slot < 0 || static_cast<size_t>(slot) + 1 >= start.size()) return;
+        for(int i = start[slot]; i < start[slot + 1]; i++) callback(entries[i]);
+    }
+
+private:
+    std::vector<int> start;
+    std::vector<int> entries;
+};
+
+// Строка с подстановкой {name}, разобранная при загрузке:
+// куски текста чередуются со слотами переменных.
+class TextTemplate {
+public:
+    void compile(const std::string& text, VariableStore& variables);
+    // Неопределенная переменная остается в тексте как {name}
+    void format(const VariableStore& variables, std::string& out) const;
+
+private:
+    struct Part {
+        std::string text;
+        int slot;  // -1 - только текст
+    };
+    std::vector<Part> parts;
+};
+
+#endif
@@ -11,10 +11,14 @@ VideoPlayer::VideoPlayer(SDL_Renderer* renderer) : renderer(renderer) {
     videoTexture = nullptr;
     rgbaBuffer = nullptr;
     tempSurface = nullptr;
+    frameSurface = nullptr;
+    frameReady = false;
+    hasFrame = false;
 }
 
 VideoPlayer::~VideoPlayer() {
     cleanup();
+    if(videoTexture) SDL_DestroyTexture(videoTexture);
 }
 
 void VideoPlayer::cleanup() {
@@ -24,17 +28,24 @@ void VideoPlayer::cleanup() {
     if(packet) av_packet_free(&packet);
     if(codecContext) avcodec_free_context(&codecContext);
     if(formatContext) avformat_close_input(&formatContext);
-    if(videoTexture) SDL_DestroyTexture(videoTexture);
     if(rgbaBuffer) av_free(rgbaBuffer);
     if(tempSurface) SDL_FreeSurface(tempSurface);
     
+    // Текстуру не трогаем - она принадлежит потоку рендера и переиспользуется
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        if(frameSurface) SDL_FreeSurface(frameSurface);
+        frameSurface = nullptr;
+        frameReady = false;
+        hasFrame = false;
+    }
+    
     swsContext = nullptr;
     frameRGBA = nullptr;
     frame = nullptr;
     packet = nullptr;
     codecContext = nullptr;
     formatContext = nullptr;
-    videoTexture = nullptr;
     rgbaBuffer = nullptr;
     tempSurface = nullptr;
 }
@@ -97,6 +108,18 @@ bool VideoPlayer::initialize(const std::string& path) {
         return false;
     }
 
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        frameSurface = SDL_CreateRGBSurface(
+            0, codecContext->width, codecContext->height, 32,
+            0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000
+        );
+        if (!frameSurface) {
+            std::cout << "Failed to create surface: " << SDL_GetError() << std::endl;
+            return false;
+        }
+    }
+
     // Allocate RGBA buffer
     int rgbaBytes = av_image_get_buffer_size(AV_PIX_FMT_RGBA, codecContext->width, codecContext->height, 1);
     rgbaBuffer = (uint8_t*)av_malloc(rgbaBytes);
@@ -193,22 +216,14 @@ bool VideoPlayer::decodeNextFrame() {
                     // Обрабатываем зеленый экран
                     processGreenScreenSDL(tempSurface);
                     
-                    // НЕ используем color key - он может быть причиной проблем
-                    // Создаем текстуру с поддержкой альфа-канала
-                    if (videoTexture) {
-                        SDL_DestroyTexture(videoTexture);
-                    }
-                    
-                    videoTexture = SDL_CreateTextureFromSurface(renderer, tempSurface);
-                    if (!videoTexture) {
-                        std::cout << "Failed to create texture: " << SDL_GetError() << std::endl;
-                        av_packet_unref(packet);
-                        return false;
+                    // Отдаем кадр потоку рендера, текстура обновится в acquireTexture
+                    {
+                        std::lock_guard<std::mutex> lock(frameMutex);
+                        std::swap(tempSurface, frameSurface);
+                        frameReady = true;
+                        hasFrame = true;
                     }
                     
-                    // Устанавливаем режим смешивания для прозрачности
-                    SDL_SetTextureBlendMode(videoTexture, SDL_BLENDMODE_BLEND);
-                    
                     av_packet_unref(packet);
                     return true;
                 }
@@ -218,3 +233,30 @@ bool VideoPlayer::decodeNextFrame() {
     }
     return false;
 }
+
+SDL_Texture* VideoPlayer::acquireTexture() {
+    std::lock_guard<std::mutex> lock(frameMutex);
+    if(!hasFrame) return nullptr;
+
+    if(frameReady && frameSurface) {
+        int texWidth = 0, texHeight = 0;
+        if(videoTexture) {
+            SDL_QueryTexture(videoTexture, nullptr, nullptr, &texWidth, &texHeight);
+        }
+        // Потоковую текстуру пересоздаем только при смене размера видео
+        if(!videoTexture || texWidth != frameSurface->w || texHeight != frameSurface->h) {
+            if(videoTexture) SDL_DestroyTexture(videoTexture);
+            videoTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                SDL_TEXTUREACCESS_STREAMING, frameSurface->w, frameSurface->h);
+            if (!videoTexture) {
+                std::cout << "Failed to create texture: " << SDL_GetError() << std::endl;
+                return nullptr;
+            }
+            // Устанавливаем режим смешивания для прозрачности
+            SDL_SetTextureBlendMode(videoTexture, SDL_BLENDMODE_BLEND);
+        }
+        SDL_UpdateTexture(videoTexture, nullptr, frameSurface->pixels, frameSurface->pitch);
+        frameReady = false;
+    }
+    return videoTexture;
+}
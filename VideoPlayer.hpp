@@ -3,6 +3,7 @@
 
 #include "SDL2/SDL.h"
 #include <string>
+#include <mutex>
 extern "C" {
     #include <libavcodec/avcodec.h>
     #include <libavformat/avformat.h>
@@ -18,7 +19,8 @@ public:
     bool initialize(const std::string& path);
     bool decodeNextFrame();
     void cleanup();
-    SDL_Texture* getTexture() const { return videoTexture; }
+    // Загружает последний декодированный кадр в текстуру. Только из потока рендера.
+    SDL_Texture* acquireTexture();
     Uint32 getFrameDelay() const { return frameDelay; }
 
 private:
@@ -33,7 +35,11 @@ private:
     int videoStreamIndex;
     Uint32 frameDelay;
     uint8_t* rgbaBuffer;
-    SDL_Surface* tempSurface;
+    SDL_Surface* tempSurface;   // Сюда декодирует поток симуляции
+    SDL_Surface* frameSurface;  // Готовый кадр, ждущий загрузки в текстуру
+    bool frameReady;
+    bool hasFrame;
+    std::mutex frameMutex;
     
     void processGreenScreenSDL(SDL_Surface* surface);
 };
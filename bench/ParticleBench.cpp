@@ -0,0 +1,58 @@
+// Пропускная способность частиц на одном ядре: update (интеграция и удаление мертвых)
+// и сборка вершин для пулов фиксированной емкости. Запуск: make bench
+#include "ParticleSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+static double seconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+int main() {
+    const int capacities[] = {1024, 16384, 262144};
+    const float deltaTime = 1.0f / 40.0f;  // Шаг симуляции игры
+
+    std::printf("%10s %16s %16s\n", "capacity", "update, M/s", "vertices, M/s");
+    for(int capacity : capacities) {
+        ParticleEmitterConfig config;
+        config.capacity = capacity;
+        config.rate = 0.0f;  // Пул заполняется одним burst и остается полным
+        config.area = {0, 0, 800, 600};
+        config.minVelX = -50.0f;
+        config.maxVelX = 50.0f;
+        config.minVelY = -100.0f;
+        config.maxVelY = 0.0f;
+        config.gravityY = 98.0f;
+        config.minLife = 1e6f;  // Частицы не умирают: каждый проход обрабатывает весь пул
+        config.maxLife = 1e6f;
+        ParticleEmitter emitter(config);
+        emitter.burst(capacity);
+
+        // Около 64M обновлений частиц на замер, но не меньше 16 проходов
+        const int passes = std::max(16, 64 * 1024 * 1024 / capacity);
+        emitter.update(deltaTime);  // Прогрев
+        double start = seconds();
+        for(int i = 0; i < passes; i++) {
+            emitter.update(deltaTime);
+        }
+        const double updateTime = seconds() - start;
+
+        std::vector<SDL_Vertex> vertices;
+        emitter.buildVertices(vertices);
+        const int vertexPasses = std::max(4, passes / 8);
+        start = seconds();
+        for(int i = 0; i < vertexPasses; i++) {
+            emitter.buildVertices(vertices);
+        }
+        const double vertexTime = seconds() - start;
+
+        const double particles = static_cast<double>(emitter.getAliveCount());
+        std::printf("%10d %16.1f %16.1f\n", capacity,
+                    particles * passes / updateTime / 1e6,
+                    particles * vertexPasses / vertexTime / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+// Поиск пути на больших сетках: A*, построение полей направлений и их кэш
+// при точечных изменениях клеток (выборочная инвалидация против полной). Запуск: make bench.
+// Заодно сверяет поля с A*: путь по полю должен быть той же длины, что и найденный A*
+#include "Pathfinder.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+static double seconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t rngState = 12345;
+
+static uint32_t nextRandom(uint32_t range) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState % range;
+}
+
+static std::pair<int, int> randomFreeCell(const Pathfinder& pathfinder) {
+    while(true) {
+        std::pair<int, int> cell(nextRandom(pathfinder.getRows()), nextRandom(pathfinder.getCols()));
+        if(!pathfinder.isBlocked(cell.first, cell.second)) return cell;
+    }
+}
+
+// Длина пути по полю от start; -1, если поле не ведет к цели
+static int walkField(const FlowField& field, std::pair<int, int> start) {
+    int steps = 0;
+    std::pair<int, int> cell = start;
+    std::pair<int, int> next;
+    while(field.nextCell(cell.first, cell.second, next)) {
+        cell = next;
+        if(++steps > field.rows * field.cols) return -1;
+    }
+    return cell == field.goal ? steps : -1;
+}
+
+static bool benchGrid(int size) {
+    CollisionGrid grid;
+    grid.resize(size, size);
+    // 30% твердых клеток, еще 5% закрыты маской - как сцена с попиксельными коллизиями
+    std::vector<uint8_t> maskCells(static_cast<size_t>(size) * size, 0);
+    for(int row = 0; row < size; row++) {
+        for(int col = 0; col < size; col++) {
+            const uint32_t roll = nextRandom(100);
+            if(roll < 30) grid.set(row, col, CollisionLayer::Solid, true);
+            else if(roll < 35) maskCells[row * size + col] = 1;
+        }
+    }
+    Pathfinder pathfinder;
+    pathfinder.setGrid(&grid, CollisionGrid::layerBit(CollisionLayer::Solid), size, size);
+    pathfinder.setMaskCells(maskCells, size, size);
+
+    // A*: одиночные запросы между случайными свободными клетками
+    const int queries = 64;
+    std::vector<std::pair<int, int>> path;
+    int found = 0;
+    double start = seconds();
+    for(int i = 0; i < queries; i++) {
+        if(pathfinder.findPath(randomFreeCell(pathfinder), randomFreeCell(pathfinder), path)) found++;
+    }
+    const double astarTime = (seconds() - start) / queries;
+
+    // Поля: каждое строится заново (кэш сброшен), затем сверяется с A*
+    const int fields = 16;
+    double buildTime = 0.0;
+    bool consistent = true;
+    for(int i = 0; i < fields; i++) {
+        const std::pair<int, int> goal = randomFreeCell(pathfinder);
+        pathfinder.invalidateAll();
+        start = seconds();
+        const FlowField* field = pathfinder.getFlowField(goal);
+        buildTime += seconds() - start;
+
+        for(int actor = 0; actor < 8; actor++) {
+            const std::pair<int, int> from = randomFreeCell(pathfinder);
+            const bool reachable = pathfinder.findPath(from, goal, path);
+            const int steps = walkField(*field, from);
+            if(reachable != (steps >= 0) || (reachable && steps != static_cast<int>(path.size()))) {
+                std::printf("  mismatch: goal %d,%d from %d,%d: A* %d, field %d\n", goal.first, goal.second,
+                            from.first, from.second, reachable ? static_cast<int>(path.size()) : -1, steps);
+                consistent = false;
+            }
+        }
+    }
+    buildTime /= fields;
+
+    // Кэш полей при изменениях клеток: выборочная инвалидация против сброса всего кэша
+    std::vector<std::pair<int, int>> goals;
+    for(int i = 0; i < Pathfinder::MAX_FLOW_FIELDS; i++) {
+        goals.push_back(randomFreeCell(pathfinder));
+    }
+    const int changes = 32;
+    double times[2] = {0.0, 0.0};
+    for(int incremental = 0; incremental < 2; incremental++) {
+        const uint32_t seed = rngState;
+        pathfinder.invalidateAll();
+        for(const auto& goal : goals) pathfinder.getFlowField(goal);
+
+        start = seconds();
+        for(int i = 0; i < changes; i++) {
+            const int row = nextRandom(size);
+            const int col = nextRandom(size);
+            const bool solid = !grid.test(row, col, CollisionLayer::Solid);
+            grid.set(row, col, CollisionLayer::Solid, solid);
+            if(incremental) pathfinder.onCellChanged(row, col);
+            else pathfinder.invalidateAll();
+            // Актеры запрашивают свои поля каждый тик
+            for(const auto& goal : goals) pathfinder.getFlowField(goal);
+        }
+        times[incremental] = (seconds() - start) / changes;
+
+        // Второй проход повторяет те же изменения: возвращаем сетку и генератор
+        rngState = seed;
+        for(int i = 0; i < changes; i++) {
+            const int row = nextRandom(size);
+            const int col = nextRandom(size);
+            grid.set(row, col, CollisionLayer::Solid, !grid.test(row, col, CollisionLayer::Solid));
+        }
+        rngState = seed;
+    }
+    // Сетка вернулась, но кэш видел изменения - сбрасываем перед следующим размером
+    pathfinder.invalidateAll();
+
+    std::printf("%5dx%-5d %9.3f %6d/%-3d %11.3f %13.3f %13.3f\n", size, size, astarTime * 1e3, found, queries,
+                buildTime * 1e3, times[0] * 1e3, times[1] * 1e3);
+    return consistent;
+}
+
+int main() {
+    std::printf("%-11s %9s %10s %11s %13s %13s\n", "grid", "A*, ms", "found", "field, ms",
+                "full inv, ms", "incr inv, ms");
+    bool ok = true;
+    for(int size : {128, 512, 1024}) {
+        ok = benchGrid(size) && ok;
+    }
+    std::printf("inv columns: one cell change plus %d cached fields requested again\n", Pathfinder::MAX_FLOW_FIELDS);
+    if(!ok) {
+        std::printf("flow fields disagree with A*\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+// Скрипты сцены: размер байткода и скорость диспетчеризации команд.
+// "До" - разбор JSON на каждом запуске, как выполнялись скрипты до компиляции:
+// копия команд, сравнение имен строками, выражения и шаблоны разбираются заново.
+// "После" - ScriptScheduler по скомпилированной программе. Запуск: make bench
+#include "ScriptScheduler.hpp"
+#include <chrono>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+static double seconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Типичная группа: счетчики, ветвления по переменным, сообщения с подстановкой, частицы и коллизии.
+// Только мгновенные команды - замеряется диспетчеризация, а не ожидание событий
+static const char* SCRIPT_GROUP = R"([
+    {"setVar": ["visits", "visits + 1"]},
+    {"playerMovement": false},
+    {"if": {
+        "condition": "visits == 1",
+        "then": [
+            {"setVar": ["greeting", "Hello, {playerName}!"]},
+            {"showDebugMessage": "first visit of {playerName}"},
+            {"particles": ["sparks", true]}
+        ],
+        "else": [
+            {"setVar": ["greeting", "Welcome back"]},
+            {"particleBurst": ["sparks", 32]}
+        ]
+    }},
+    {"setVar": ["gold", "gold + visits * 10"]},
+    {"if": {
+        "condition": "gold >= 100 && !doorOpen",
+        "then": [
+            {"setVar": ["doorOpen", "true"]},
+            {"setCollision": [4, 7, false]},
+            {"setCollision": [4, 8, "trigger", true]},
+            {"showDebugMessage": "door opened with {gold} gold"}
+        ]
+    }},
+    {"parallel": [
+        [{"particles": ["smoke", true]}, {"particleBurst": ["smoke", 16]}],
+        [{"setVar": ["torch", "visits % 2 == 0"]}, {"particles": ["torchFire", true]}]
+    ]},
+    {"if": {
+        "condition": "torch || gold > 500",
+        "then": [{"particleBurst": ["torchFire", 8]}]
+    }},
+    {"setVar": ["lastScene", "'cave'"]},
+    {"wait": 0},
+    {"playerMovement": true}
+])";
+
+// Команды вместе с вложенными, без служебных if/parallel
+static int countCommands(const json& block) {
+    int count = 0;
+    for(const auto& cmdData : block) {
+        for(auto it = cmdData.begin(); it != cmdData.end(); ++it) {
+            if(it.key() == "if") {
+                if(it.value().contains("then")) count += countCommands(it.value()["then"]);
+                if(it.value().contains("else")) count += countCommands(it.value()["else"]);
+            } else if(it.key() == "parallel" || it.key() == "race") {
+                for(const auto& branch : it.value()) count += countCommands(branch);
+            } else {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// Прежний путь выполнения: команда - имя и копия JSON-параметра
+struct JsonCommand {
+    std::string command;
+    json parameter;
+};
+
+struct JsonInterpreter {
+    explicit JsonInterpreter(VariableStore& variables) : variables(variables) {}
+
+    VariableStore& variables;
+    std::vector<JsonCommand> activeCommands;
+    std::string text;
+    int effects = 0;
+
+    void collect(const json& block) {
+        for(const auto& cmdData : block) {
+            for(auto it = cmdData.begin(); it != cmdData.end(); ++it) {
+                if(it.key() == "if") {
+                    ScriptExpression condition;
+                    std::string error;
+                    condition.compile(it.value()["condition"].get<std::string>(), error, variables);
+                    const char* branch = condition.evaluateCondition(variables) ? "then" : "else";
+                    if(it.value().contains(branch)) collect(it.value()[branch]);
+                } else if(it.key() == "parallel" || it.key() == "race") {
+                    for(const auto& branch : it.value()) collect(branch);
+                } else {
+                    activeCommands.push_back({it.key(), it.value()});
+                }
+            }
+        }
+    }
+
+    void run(const json& block) {
+        activeCommands.clear();
+        collect(block);
+        while(!activeCommands.empty()) {
+            start(activeCommands.front());
+            activeCommands.erase(activeCommands.begin());
+        }
+    }
+
+    void start(const JsonCommand& command) {
+        if(command.command == "showDialog" || command.command == "showVid") {
+            effects++;
+        } else if(command.command == "showDebugMessage") {
+            TextTemplate message;
+            message.compile(command.parameter.get<std::string>(), variables);
+            message.format(variables, text);
+        } else if(command.command == "wait" || command.command == "fadeIn" || command.command == "fadeOut") {
+            effects += command.parameter.get<double>() > 0.0;
+        } else if(command.command == "playerMovement") {
+            effects += command.parameter.get<bool>();
+        } else if(command.command == "setVar") {
+            const int slot = variables.resolve(command.parameter[0].get<std::string>());
+            ScriptExpression expression;
+            std::string error;
+            if(expression.compile(command.parameter[1].get<std::string>(), error, variables)) {
+                expression.assignTo(variables, slot);
+            } else {
+                TextTemplate value;
+                value.compile(command.parameter[1].get<std::string>(), variables);
+                value.format(variables, text);
+                variables.setString(slot, text);
+            }
+        } else if(command.command == "setCollision") {
+            effects += command.parameter[0].get<int>() + command.parameter[1].get<int>();
+        } else if(command.command == "walkTo") {
+            effects++;
+        } else if(command.command == "particles" || command.command == "particleBurst") {
+            effects += static_cast<int>(command.parameter[0].get<std::string>().size());
+        }
+    }
+};
+
+static void resetVariables(VariableStore& variables) {
+    variables.set("visits", 0);
+    variables.set("gold", 0);
+    variables.set("doorOpen", false);
+    variables.set("playerName", std::string("Alice"));
+}
+
+int main() {
+    const json commands = json::parse(SCRIPT_GROUP);
+    VariableStore variables;
+    resetVariables(variables);
+
+    ScriptProgram program;
+    ScriptCompiler::compile(commands, "bench", program, variables);
+
+    // Размер: прежде команда хранила имя и дерево JSON, теперь - инструкция и пулы программы
+    const int commandCount = countCommands(commands);
+    size_t stringBytes = 0;
+    for(const auto& value : program.strings) stringBytes += value.size();
+    std::printf("commands: %d, instructions: %zu x %zu bytes\n", commandCount, program.code.size(),
+                sizeof(ScriptInstruction));
+    std::printf("pools: %zu strings (%zu bytes), %zu templates, %zu expressions\n", program.strings.size(),
+                stringBytes, program.templates.size(), program.expressions.size());
+    std::printf("per command: code %.1f bytes, json text %.1f bytes\n",
+                static_cast<double>(program.code.size() * sizeof(ScriptInstruction)) / commandCount,
+                static_cast<double>(commands.dump().size()) / commandCount);
+
+    // После: исполнитель делает ту же работу, что и start() прежнего пути, по операндам инструкций
+    ScriptScheduler scheduler;
+    std::string text;
+    int effects = 0;
+    scheduler.setExecutor([&](const ScriptProgram& current, const ScriptInstruction& ins) {
+        switch(ins.op) {
+        case ScriptOp::DebugMessage:
+            if(ins.flag & SCRIPT_FLAG_INTERPOLATE) current.templates[ins.arg].format(variables, text);
+            else text = current.string(ins.arg);
+            break;
+        case ScriptOp::SetVar:
+            if(ins.flag & SCRIPT_FLAG_TEXT) {
+                if(ins.flag & SCRIPT_FLAG_INTERPOLATE) current.templates[ins.b].format(variables, text);
+                else text = current.string(static_cast<uint16_t>(ins.b));
+                variables.setString(ins.a, text);
+            } else {
+                current.expressions[ins.b].assignTo(variables, ins.a);
+            }
+            break;
+        case ScriptOp::SetCollision:
+            effects += ins.a + ins.b;
+            break;
+        case ScriptOp::Particles:
+        case ScriptOp::ParticleBurst:
+            effects += static_cast<int>(current.string(ins.arg).size());
+            break;
+        default:
+            effects++;
+            break;
+        }
+        return ScriptEvent::None;
+    });
+
+    const int runs = 100000;
+    double start = seconds();
+    for(int i = 0; i < runs; i++) {
+        scheduler.start(program);
+        scheduler.update(1.0f / 40.0f, variables);
+    }
+    const double compiledTime = seconds() - start;
+
+    resetVariables(variables);
+    JsonInterpreter interpreter(variables);
+    start = seconds();
+    for(int i = 0; i < runs; i++) {
+        interpreter.run(commands);
+    }
+    const double jsonTime = seconds() - start;
+
+    std::printf("%-10s %14s %14s\n", "dispatch", "ns/command", "us/run");
+    std::printf("%-10s %14.1f %14.3f\n", "json", jsonTime / runs / commandCount * 1e9, jsonTime / runs * 1e6);
+    std::printf("%-10s %14.1f %14.3f\n", "bytecode", compiledTime / runs / commandCount * 1e9,
+                compiledTime / runs * 1e6);
+    std::printf("speedup: %.1fx\n", jsonTime / compiledTime);
+    return 0;
+}
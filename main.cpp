@@ -1,6 +1,7 @@
 #include "Game.hpp"
 #include <string>
 #include <fstream>
+#include <sstream>
 #include "nlohmann/json.hpp"
 
 using json = nlohmann::json;
@@ -9,6 +10,8 @@ Game *game = nullptr;
 
 int main(int argc, char* argv[]) {
     std::string gamePath = ".";
+    HeadlessOptions headless;
+    RecordingOptions recording;
 
     // Обработка аргументов командной строки
     for(int i = 1; i < argc; i++) {
@@ -16,10 +19,39 @@ int main(int argc, char* argv[]) {
         if(arg == "--game-path" && i + 1 < argc) {
             gamePath = argv[i + 1];
             i++; // Пропускаем следующий аргумент, так как мы его уже обработали
+        } else if(arg == "--headless") {
+            headless.enabled = true;
+        } else if(arg == "--ticks" && i + 1 < argc) {
+            headless.ticks = std::stoull(argv[++i]);
+        } else if(arg == "--seed" && i + 1 < argc) {
+            headless.seed = static_cast<Uint32>(std::stoul(argv[++i]));
+        } else if(arg == "--input-script" && i + 1 < argc) {
+            headless.inputScript = argv[++i];
+        } else if(arg == "--dump-frames" && i + 1 < argc) {
+            // Список тиков через запятую: 1,100,250
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while(std::getline(list, item, ',')) {
+                if(!item.empty()) headless.dumpFrames.insert(std::stoull(item));
+            }
+        } else if(arg == "--dump-every" && i + 1 < argc) {
+            headless.dumpEvery = std::stoull(argv[++i]);
+        } else if(arg == "--dump-dir" && i + 1 < argc) {
+            headless.dumpDir = argv[++i];
+        } else if(arg == "--record" && i + 1 < argc) {
+            recording.recordPath = argv[++i];
+        } else if(arg == "--replay" && i + 1 < argc) {
+            recording.replayPath = argv[++i];
+        } else if(arg == "--frame-log" && i + 1 < argc) {
+            recording.frameLogPath = argv[++i];
+        } else if(arg == "--script-profile" && i + 1 < argc) {
+            recording.scriptProfilePath = argv[++i];
         }
     }
 
     game = new Game();
+    game->setHeadless(headless);
+    game->setRecording(recording);
 
     // Read window settings from config
     std::string settingsPath = gamePath + "/settings.json";
@@ -50,23 +82,12 @@ int main(int argc, char* argv[]) {
     game->init(title.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 
                width, height, fullscreen, gamePath);
 
-    const int FPS = 40;  // Changed from 30 to 40
-    const int frameDelay = 1000 / FPS;
-
-    Uint32 frameStart;
-    int frameTime;
-
+    // Темп кадров задается в settings.json (vsync / maxFps), шаг симуляции фиксирован
     while (game->running()){
-        frameStart = SDL_GetTicks();
-
         game->handleEvents();
         game->update();
         game->render();
-
-        frameTime = SDL_GetTicks() - frameStart;
-        if(frameDelay > frameTime) {
-            SDL_Delay(frameDelay - frameTime);
-        }
+        game->waitForNextFrame();
     }
 
     game->clean();